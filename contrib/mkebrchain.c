@@ -0,0 +1,99 @@
+/*
+ * mkebrchain.c -- write a disk image with a long extended ptbl chain
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ * Test and benchmark image for the extended ptbl walker. The
+ * extended partition starts at sector 2048, every link is 64
+ * sectors long and holds one logical partition of 63 sectors.
+ * With a loop argument the last link points back to that link.
+ *
+ *	cc -o mkebrchain mkebrchain.c
+ *	./mkebrchain chain.img 5000
+ *	time gpart -v -d chain.img >/dev/null
+ *	./mkebrchain loop.img 5000 100
+ *	gpart -v -d loop.img
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SSIZE		512
+#define EXTSTART	2048
+#define LINKSECS	64
+
+static void put_entry(unsigned char *e, int typ, unsigned long start, unsigned long size)
+{
+	int i;
+
+	e[4] = typ;
+	for (i = 0; i < 4; i++) {
+		e[8 + i] = start >> (8 * i);
+		e[12 + i] = size >> (8 * i);
+	}
+}
+
+static void put_sector(int fd, unsigned long sec, unsigned char *buf)
+{
+	buf[510] = 0x55;
+	buf[511] = 0xAA;
+	if (pwrite(fd, buf, SSIZE, (off_t)sec * SSIZE) != SSIZE) {
+		perror("pwrite");
+		exit(1);
+	}
+}
+
+int main(int ac, char **av)
+{
+	unsigned char buf[SSIZE];
+	unsigned long n, loop = 0, i, extsize;
+	int fd;
+
+	if ((ac < 3) || ((n = strtoul(av[2], 0, 0)) == 0)) {
+		fprintf(stderr, "usage: %s image links [loop to link]\n", av[0]);
+		return (1);
+	}
+	if (ac > 3)
+		loop = strtoul(av[3], 0, 0);
+	if ((loop >= n) || ((fd = open(av[1], O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)) {
+		fprintf(stderr, "%s: cannot create %s\n", av[0], av[1]);
+		return (1);
+	}
+
+	extsize = n * LINKSECS;
+	memset(buf, 0, sizeof(buf));
+	put_entry(buf + 446, 0x05, EXTSTART, extsize);
+	put_sector(fd, 0, buf);
+
+	/*
+	 * link offsets are relative to the start of the extended
+	 * partition, logical partitions to their link.
+	 */
+
+	for (i = 0; i < n; i++) {
+		memset(buf, 0, sizeof(buf));
+		put_entry(buf + 446, 0x83, 1, LINKSECS - 1);
+		if (i + 1 < n)
+			put_entry(buf + 462, 0x05, (i + 1) * LINKSECS, LINKSECS);
+		else if (loop)
+			put_entry(buf + 462, 0x05, loop * LINKSECS, LINKSECS);
+		put_sector(fd, EXTSTART + i * LINKSECS, buf);
+	}
+	if (ftruncate(fd, (off_t)(EXTSTART + extsize) * SSIZE) == -1) {
+		perror("ftruncate");
+		return (1);
+	}
+	close(fd);
+	return (0);
+}
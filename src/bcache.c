@@ -0,0 +1,275 @@
+/*
+ * bcache.c -- gpart module read cache and scratch buffers
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "gpart.h"
+#include "bcache.h"
+
+static int bc_hash(blk_cache *c, s64_t blk) { return ((int)((blk * 0x9E3779B97F4A7C15ULL) >> 40) & c->c_hmask); }
+
+/*
+ * a cache of mb megabytes, none if mb is 0.
+ */
+
+void bc_create(disk_desc *d, long mb)
+{
+	blk_cache *c;
+	int i, psize = getpagesize();
+
+	d->d_bc = 0;
+	if (mb <= 0)
+		return;
+	c = (blk_cache *)alloc(sizeof(blk_cache));
+	c->c_bsize = max(BC_BLKSIZE, d->d_ssize);
+	c->c_nblocks = max(mb * 1024 * 1024 / c->c_bsize, 1);
+	for (c->c_hmask = 1; c->c_hmask < c->c_nblocks; c->c_hmask <<= 1)
+		;
+	c->c_hash = (bc_block **)alloc(c->c_hmask * sizeof(bc_block *));
+	c->c_hmask--;
+	c->c_blocks = (bc_block *)alloc(c->c_nblocks * sizeof(bc_block));
+	c->c_ubuf = alloc(c->c_nblocks * c->c_bsize + psize);
+	for (i = 0; i < c->c_nblocks; i++) {
+		c->c_blocks[i].b_blk = -1;
+		c->c_blocks[i].b_data = align(c->c_ubuf, psize) + i * c->c_bsize;
+		c->c_blocks[i].b_older = (i > 0) ? &c->c_blocks[i - 1] : 0;
+		c->c_blocks[i].b_newer = (i < c->c_nblocks - 1) ? &c->c_blocks[i + 1] : 0;
+	}
+	c->c_oldest = &c->c_blocks[0];
+	c->c_newest = &c->c_blocks[c->c_nblocks - 1];
+	d->d_bc = c;
+}
+
+void bc_destroy(disk_desc *d)
+{
+	blk_cache *c = d->d_bc;
+
+	if (c == 0)
+		return;
+	free((void *)c->c_ubuf);
+	free((void *)c->c_blocks);
+	free((void *)c->c_hash);
+	free((void *)c);
+	d->d_bc = 0;
+}
+
+static void bc_touch(blk_cache *c, bc_block *b)
+{
+	if (b == c->c_newest)
+		return;
+	if (b->b_older)
+		b->b_older->b_newer = b->b_newer;
+	else
+		c->c_oldest = b->b_newer;
+	b->b_newer->b_older = b->b_older;
+	b->b_older = c->c_newest;
+	b->b_newer = 0;
+	c->c_newest->b_newer = b;
+	c->c_newest = b;
+}
+
+static bc_block *bc_get(disk_desc *d, s64_t blk)
+{
+	blk_cache *c = d->d_bc;
+	bc_block *b, **bp;
+	int h = bc_hash(c, blk);
+
+	for (b = c->c_hash[h]; b; b = b->b_hnext)
+		if (b->b_blk == blk) {
+			c->c_hits++;
+			bc_touch(c, b);
+			return (b);
+		}
+
+	/*
+	 * reuse the least recently used block.
+	 */
+
+	c->c_misses++;
+	b = c->c_oldest;
+	if (b->b_blk >= 0) {
+		for (bp = &c->c_hash[bc_hash(c, b->b_blk)]; *bp != b; bp = &(*bp)->b_hnext)
+			;
+		*bp = b->b_hnext;
+	}
+	b->b_blk = blk;
+	b->b_len = 0;
+	if (l64seek(d->d_fd, blk * c->c_bsize, SEEK_SET) != -1)
+		if ((b->b_len = read(d->d_fd, b->b_data, c->c_bsize)) < 0)
+			b->b_len = 0;
+	b->b_hnext = c->c_hash[h];
+	c->c_hash[h] = b;
+	bc_touch(c, b);
+	return (b);
+}
+
+static s64_t now_us()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return ((s64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/*
+ * give the following module reads a budget of bytes and of ms
+ * milliseconds, 0 means no limit. Garbage that looks like a
+ * file system could otherwise make a module read for a long
+ * time. Once it is exceeded d->d_rbover is set and gm_read()
+ * fails.
+ */
+
+void gm_budget(disk_desc *d, s64_t bytes, long ms)
+{
+	d->d_rbmax = bytes;
+	d->d_rbused = 0;
+	d->d_rbend = ms ? now_us() + (s64_t)ms * 1000 : 0;
+	d->d_rbover = 0;
+}
+
+/*
+ * read len bytes at byte offset ofs of the device for a module.
+ * Returns the number of bytes read like read(2). The file
+ * position of d->d_fd is undefined afterwards. Only the small
+ * confirmation reads are cached, a large one (a LUKS2 header,
+ * the end of a md member) is read at once and would only push
+ * everything else out of the cache.
+ */
+
+ssize_t gm_read(disk_desc *d, s64_t ofs, void *buf, size_t len)
+{
+	blk_cache *c = d->d_bc;
+	bc_block *b;
+	ssize_t n, done = 0, bofs;
+
+	if (d->d_rbover || (ofs < 0))
+		return (-1);
+	d->d_rbused += len;
+	if ((d->d_rbmax && (d->d_rbused > d->d_rbmax)) || (d->d_rbend && (now_us() > d->d_rbend))) {
+		d->d_rbover = 1;
+		return (-1);
+	}
+	if ((c == 0) || (len > BC_MAXBLKS * c->c_bsize)) {
+		if (c)
+			c->c_misses++;
+		if (l64seek(d->d_fd, ofs, SEEK_SET) == -1)
+			return (-1);
+		return (read(d->d_fd, buf, len));
+	}
+	while (done < len) {
+		b = bc_get(d, ofs / c->c_bsize);
+		bofs = ofs % c->c_bsize;
+		if (b->b_len <= bofs)
+			break;
+		n = min(b->b_len - bofs, len - done);
+		memcpy((byte_t *)buf + done, b->b_data + bofs, n);
+		done += n;
+		ofs += n;
+		if (b->b_len < c->c_bsize)
+			break;
+	}
+	return (done);
+}
+
+/*
+ * a page aligned scratch buffer of at least len bytes, not
+ * cleared. The buffers are kept until gm_freebufs(), so modules
+ * and the ptbl reading do not allocate memory for each check.
+ */
+
+byte_t *gm_getbuf(disk_desc *d, size_t len)
+{
+	scratch_buf *b, *fb = 0;
+	size_t psize = getpagesize();
+
+	for (b = d->d_bufs; b < &d->d_bufs[GM_NBUFS]; b++) {
+		if (b->b_used)
+			continue;
+		if (b->b_size >= len) {
+			fb = b;
+			break;
+		}
+		if ((fb == 0) || (b->b_size > fb->b_size))
+			fb = b;
+	}
+	if (fb == 0)
+		pr(FATAL, EM_NOSCRATCH, GM_NBUFS);
+	if (fb->b_size < len) {
+		if (fb->b_ubuf)
+			free((void *)fb->b_ubuf);
+		if ((fb->b_ubuf = (byte_t *)malloc(len + psize)) == 0)
+			pr(FATAL, EM_MALLOCFAILED, len + psize);
+		fb->b_buf = align(fb->b_ubuf, psize);
+		fb->b_size = len;
+	}
+	fb->b_used = 1;
+	return (fb->b_buf);
+}
+
+void gm_putbuf(disk_desc *d, byte_t *buf)
+{
+	scratch_buf *b;
+
+	for (b = d->d_bufs; b < &d->d_bufs[GM_NBUFS]; b++)
+		if (b->b_used && (b->b_buf == buf)) {
+			b->b_used = 0;
+			return;
+		}
+}
+
+void gm_freebufs(disk_desc *d)
+{
+	scratch_buf *b;
+
+	for (b = d->d_bufs; b < &d->d_bufs[GM_NBUFS]; b++)
+		if (b->b_ubuf)
+			free((void *)b->b_ubuf);
+	memset(d->d_bufs, 0, sizeof(d->d_bufs));
+}
+
+/*
+ * len zeroed bytes which stay valid until gm_freearena(). Nothing
+ * is freed singly, so allocating is a pointer bump.
+ */
+
+byte_t *gm_arena(disk_desc *d, size_t len)
+{
+	gm_chunk *a = d->d_arena;
+	size_t hdr = (sizeof(gm_chunk) + 15) & ~(size_t)15;
+	byte_t *p;
+
+	len = (len + 15) & ~(size_t)15;
+	if ((a == 0) || (a->a_used + len > a->a_size)) {
+		a = (gm_chunk *)alloc(hdr + max(len, GM_ARCHUNK));
+		a->a_size = max(len, GM_ARCHUNK);
+		a->a_next = d->d_arena;
+		d->d_arena = a;
+	}
+	p = (byte_t *)a + hdr + a->a_used;
+	a->a_used += len;
+	return (p);
+}
+
+void gm_freearena(disk_desc *d)
+{
+	gm_chunk *a;
+
+	while ((a = d->d_arena)) {
+		d->d_arena = a->a_next;
+		free((void *)a);
+	}
+}
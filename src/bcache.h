@@ -0,0 +1,65 @@
+/*
+ * bcache.h -- gpart module read cache header file
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+/*
+ * the reads modules do besides their scan window (spare super
+ * blocks, backup boot sectors, root directories) go through a
+ * small LRU cache of device blocks, see gm_read().
+ */
+
+#define BC_DEFMB	4		/* default cache size in mb */
+#define BC_BLKSIZE	4096		/* bytes per cached block */
+#define BC_MAXBLKS	4		/* larger reads bypass the cache */
+
+/*
+ * the reads of one module check are limited, see gm_budget().
+ * There is no time limit by default, the results would vary
+ * with the speed of the disk.
+ */
+
+#define RB_DEFKB	16384		/* default read budget in kb */
+#define RB_DEFMS	0		/* default time budget in ms */
+
+typedef struct bc_block
+{
+	s64_t		b_blk;		/* block number, -1 if unused */
+	ssize_t		b_len;		/* valid bytes in b_data */
+	byte_t		*b_data;
+	struct bc_block	*b_newer;	/* lru list */
+	struct bc_block	*b_older;
+	struct bc_block	*b_hnext;	/* hash chain */
+} bc_block;
+
+typedef struct blk_cache
+{
+	bc_block	*c_blocks;
+	bc_block	**c_hash;
+	bc_block	*c_newest;
+	bc_block	*c_oldest;
+	int		c_nblocks;
+	int		c_hmask;
+	ssize_t		c_bsize;
+	byte_t		*c_ubuf;
+	s64_t		c_hits;
+	s64_t		c_misses;
+} blk_cache;
+
+void bc_create(disk_desc *, long);
+void bc_destroy(disk_desc *);
+
+#endif /* _BCACHE_H */
@@ -0,0 +1,52 @@
+/*
+ * bpb.c -- gpart DOS boot sector parameter block decoding
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <string.h>
+#include "gpart.h"
+
+/*
+ * the fields are unaligned in the sector.
+ */
+
+static uint16_t get16(byte_t *p) { return (p[0] | p[1] << 8); }
+
+static uint32_t get32(byte_t *p) { return (get16(p) | (uint32_t)get16(p + 2) << 16); }
+
+/*
+ * decode the boot sector at p. FAT, NTFS and HPFS share the
+ * layout up to offset 0x24, from there FAT12/16 and HPFS
+ * continue with an extended BPB, FAT32 and NTFS with their
+ * own fields.
+ */
+
+void bpb_decode(byte_t *p, bpb_info *b)
+{
+	b->b_jmp = (p[0] == 0xeb) && (p[2] == 0x90);
+	b->b_magic = (get16(p + 510) == DOSPTMAGIC);
+	b->b_ssize = get16(p + 0x0b);
+	b->b_media = p[0x15];
+	b->b_fatlen = get16(p + 0x16);
+	if ((b->b_nsecs = get16(p + 0x13)) == 0)
+		b->b_nsecs = get32(p + 0x20);
+	b->b_extsig = p[0x26];
+	memcpy(b->b_fstype, p + 0x36, sizeof(b->b_fstype));
+	b->b_nsecs64 = get32(p + 0x28) | (uint64_t)get32(p + 0x2c) << 32;
+	b->b_mftcl = get32(p + 0x40);
+	b->b_idxcl = get32(p + 0x44);
+
+	b->b_fat = b->b_jmp && ((b->b_media == 0xf8) || (b->b_media == 0xfc)) && b->b_magic;
+	b->b_ntfs = (memcmp(p + 3, "NTFS", 4) == 0);
+	b->b_hpfs = (b->b_extsig == 0x28) && (memcmp(b->b_fstype, "HPFS    ", 8) == 0);
+}
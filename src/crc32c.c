@@ -0,0 +1,103 @@
+/*
+ * crc32c.c -- gpart crc32c (Castagnoli) checksum
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <string.h>
+#include "gpart.h"
+#include "crc32c.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	define CRC_X86
+#	include <nmmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#	define CRC_ARM
+#	include <sys/auxv.h>
+#	include <arm_acle.h>
+#	ifndef HWCAP_CRC32
+#		define HWCAP_CRC32	(1 << 7)
+#	endif
+#endif
+
+static uint32_t crc32c_sw(uint32_t, const byte_t *, size_t);
+static uint32_t (*crc32c_fun)(uint32_t, const byte_t *, size_t);
+static uint32_t crctab[256];
+
+static uint32_t crc32c_sw(uint32_t c, const byte_t *p, size_t len)
+{
+	for (; len > 0; len--)
+		c = crctab[(c ^ *p++) & 0xff] ^ (c >> 8);
+	return (c);
+}
+
+/*
+ * the crc32 instructions of SSE4.2 and ARMv8 use the Castagnoli
+ * polynomial. Superblocks are small, one 8 byte step at a time
+ * is plenty.
+ */
+
+#ifdef CRC_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t c, const byte_t *p, size_t len)
+{
+	uint64_t v, c64 = c;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, 8);
+		c64 = _mm_crc32_u64(c64, v);
+	}
+	for (c = (uint32_t)c64; len > 0; len--)
+		c = _mm_crc32_u8(c, *p++);
+	return (c);
+}
+
+static int crc32c_hwcap() { return (__builtin_cpu_supports("sse4.2")); }
+#endif
+
+#ifdef CRC_ARM
+__attribute__((target("arch=armv8-a+crc")))
+static uint32_t crc32c_hw(uint32_t c, const byte_t *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, 8);
+		c = __crc32cd(c, v);
+	}
+	for (; len > 0; len--)
+		c = __crc32cb(c, *p++);
+	return (c);
+}
+
+static int crc32c_hwcap() { return ((getauxval(AT_HWCAP) & HWCAP_CRC32) != 0); }
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	uint32_t c;
+	int i, j;
+
+	if (crc32c_fun == 0) {
+		for (i = 0; i < 256; i++) {
+			for (c = i, j = 0; j < 8; j++)
+				c = (c & 1) ? 0x82f63b78 ^ (c >> 1) : c >> 1;
+			crctab[i] = c;
+		}
+		crc32c_fun = crc32c_sw;
+#if defined(CRC_X86) || defined(CRC_ARM)
+		if (crc32c_hwcap())
+			crc32c_fun = crc32c_hw;
+#endif
+	}
+	return ((*crc32c_fun)(crc, (const byte_t *)buf, len));
+}
@@ -0,0 +1,27 @@
+/*
+ * crc32c.h -- gpart crc32c (Castagnoli) header file
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _CRC32C_H
+#define _CRC32C_H
+
+/*
+ * crc32c() continues crc over buf without the initial and final
+ * inversion, like the Linux crc32c_le(). The usual crc32c of a
+ * buffer is ~crc32c(~0, buf, len).
+ */
+
+uint32_t crc32c(uint32_t, const void *, size_t);
+
+#endif /* _CRC32C_H */
@@ -16,6 +16,7 @@
  */
 
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -143,3 +144,68 @@ int reread_partition_table(int fd)
 
 	return (1);
 }
+
+/*
+ * content classification of disk areas. Zeroed or uniformly
+ * filled areas and those with nearly random contents (encrypted
+ * or compressed data) cannot hold any recognizable structure.
+ */
+
+void byte_histogram(byte_t *buf, size_t len, unsigned long *hist)
+{
+	uint32_t h[4][256];
+	size_t i;
+	int j;
+
+	/*
+	 * four partial histograms, so increments of equal bytes
+	 * in a row don't wait for each other.
+	 */
+
+	memset(h, 0, sizeof(h));
+	for (i = 0; i + 4 <= len; i += 4) {
+		h[0][buf[i]]++;
+		h[1][buf[i + 1]]++;
+		h[2][buf[i + 2]]++;
+		h[3][buf[i + 3]]++;
+	}
+	for (; i < len; i++)
+		h[0][buf[i]]++;
+	for (j = 0; j < 256; j++)
+		hist[j] += h[0][j] + h[1][j] + h[2][j] + h[3][j];
+}
+
+/*
+ * entropy in bits per byte of a byte histogram of n bytes.
+ */
+
+double byte_entropy(unsigned long *hist, unsigned long n)
+{
+	double e = 0.0, p;
+	int i;
+
+	if (n == 0)
+		return (0.0);
+	for (i = 0; i < 256; i++)
+		if (hist[i]) {
+			p = (double)hist[i] / n;
+			e -= p * log2(p);
+		}
+	return (e);
+}
+
+int content_class(unsigned long *hist, unsigned long n)
+{
+	int i;
+
+	if (n == 0)
+		return (CC_UNKNOWN);
+	if (hist[0] == n)
+		return (CC_ZERO);
+	for (i = 1; i < 256; i++)
+		if (hist[i] == n)
+			return (CC_UNIFORM);
+	if (byte_entropy(hist, n) >= CC_ENTROPY_MIN)
+		return (CC_ENTROPY);
+	return (CC_DATA);
+}
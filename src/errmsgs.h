@@ -25,6 +25,8 @@
 #define DM_QUIT			"qQ"
 #define DM_STARTSCAN		"\nBegin scan...\n"
 #define DM_ENDSCAN		"End scan.\n"
+#define DM_STARTBACKFILL	"Scanning %d skipped ranges...\n"
+#define DM_KEEPBACKFILL		"Keep the later guess instead"
 #define DM_EDITPTBL		"Edit this table"
 #define DM_ACCEPTGUESS		"\nAccept this guess"
 #define DM_ACTWHICHPART		"Activate which partition"
@@ -50,6 +52,33 @@
 #define PM_PT_SIZE		"   size: %qdmb #s(%qd)"
 #define PM_PT_CHS		"   chs:  (%d/%d/%d)-(%d/%d/%d)d"
 #define PM_PT_HEX		"   hex: "
+#define PM_DLEXPIRED		"Deadline reached after %qd probes, %d%% of the disk covered.\n"
+#define PM_DLDONE		"Scan completed within the deadline (%qd probes), %d%% of the disk covered.\n"
+#define PM_SVHEADER		"Survey of %ld windows in sectors %qd-%qd, %qdmb read in %.1fs.\n"
+#define PM_SVCLASSES		"Windows: %ld zero, %ld uniform, %ld high entropy, %ld data, %ld ptbl, %ld fs metadata, %ld unreadable.\n"
+#define PM_SVMAP		"Layout (%qdkb per column):\n   [%s]\n"
+#define PM_SVLEGEND		"   . zero  - uniform  # high entropy  = data  P ptbl  M fs metadata  ? unreadable\n"
+#define PM_SVMOD		"   %s: %ld windows, first at sector %qd\n"
+#define PM_SVESTIMATE		"Full scan: %qd windows, %qdmb to read at %.1fmb/s, about %ld:%02ld:%02ld.\n"
+#define PM_ENDPROBEPART		"Possible partition(%s), size(%qdmb), offset(%qdmb) (end probe)\n"
+#define PM_GPTBACKUP		"GPT backup header at sector %qd, usable sectors %qd-%qd, %d entries at sector %qd\n"
+#define PM_GPTFOUND		"Valid GPT (%s header) with %d entries, confirming its partitions\n"
+#define PM_GPTNOTCONF		"GPT partition %d (sectors %qd-%qd) not confirmed, scanning it\n"
+#define PM_CFREJECTED		"Rejected partition(%s) at offset(%qdmb), not confirmed\n"
+#define PM_CFSTATS		"Deferred confirmations: %qd from the scan window, %qd read, %qd rejected.\n"
+#define PM_MODSTATS		"Module checks in the final order, %qd windows:\n"
+#define PM_MODSTAT		"   %s: %qd checks, %.2fus each, %qd hits, %qd left out\n"
+#define PM_BCSTATS		"Module read cache: %qd hits, %qd misses.\n"
+#define PM_ADSTATS		"Adaptive scan: %qd positions screened, %qd given to the modules.\n"
+#define PM_ENTSKIPPED		"Skipped %d high entropy extents (%qdmb), probed at %qdkb boundaries.\n"
+#define PM_ENTEXTENT		"   sectors %qd-%qd\n"
+#define PM_BADRANGES		"Skipped %d unreadable ranges.\n"
+#define PM_TRCSHARD		"Shard %s: sectors %qd-%qd, continues at %qd%s.\n"
+#define PM_TRCINEXT		" within an extended ptbl chain"
+#define PM_TRCREAD		"%qd positions missing in the traces were read from the device.\n"
+#define PM_IDXWRITTEN		"Index %s written: %d scanned ranges, %d hits.\n"
+#define PM_IDXSKIPPED		"Index %s: %qd known scan positions skipped.\n"
+#define PM_IDXCLASSES		"Regions: %qd zero, %qd uniform, %qd high entropy, %qd data, %qd unknown.\n"
 #define PM_G_PRIMARY		"primary "
 #define PM_G_LOGICAL		"logical "
 #define PM_G_INVALID		"invalid "
@@ -84,14 +113,35 @@
 #define EM_PTBLWRITE		"could not write partition table"
 #define EM_MBRWRITE		"could not write master boot record"
 #define EM_TOOMANYEXTP		"found more than one extended partition, skipping"
-#define EM_TOOMANYLOGP		"more than %d logical partitions encountered"
+#define EM_EPLOOP		"extended ptbl chain loops back to sector(%qd)"
 #define EM_EPILLEGALOFS		"extended ptbl illegal sector offset"
 #define EM_INVXPTBL		"invalid extended ptbl found at sector(%qd)"
 #define EM_DISCARDOVLP		"Discarded %d overlapping partition guesses"
+#define EM_BFCONFLICT		"partition guess at sector(%qd) lies within the partition guessed at sector(%qd)"
 #define EM_TOOMANYXPTS		"more than one extended partition: %d"
 #define EM_TOOMANYPPTS		"more than %d primary partitions: %d"
 #define EM_OPENLOG		"cannot open logfile %s"
+#define EM_OPENPROBES		"cannot open probe list %s: %s"
+#define EM_CKWRITE		"cannot write checkpoint %s: %s"
+#define EM_CKREAD		"cannot read checkpoint %s: %s"
+#define EM_CKINVALID		"invalid checkpoint %s"
+#define EM_CKMISMATCH		"checkpoint %s was written for another device or other options"
+#define EM_IDXWRITE		"cannot write index %s: %s"
+#define EM_IDXREAD		"cannot read index %s: %s"
+#define EM_IDXINVALID		"invalid index %s, rebuilding it"
+#define EM_IDXMISMATCH		"index %s was written for another device or contents, rebuilding it"
+#define EM_IDXNOSIZE		"size of dev(%s) unknown, not using an index"
+#define EM_TRCWRITE		"cannot write trace %s: %s"
+#define EM_TRCREAD		"cannot read trace %s: %s"
+#define EM_TRCINVALID		"invalid trace %s"
+#define EM_TRCTRUNC		"trace %s is incomplete"
+#define EM_TRCOTHERDEV		"trace %s was recorded from another device"
+#define EM_TRCMISSING		"%qd positions were not in the trace and taken as empty"
+#define EM_SVNOSIZE		"size of dev(%s) unknown or range too small, cannot survey it"
+#define EM_PROBEREAD		"cannot read sectors at probe sector(%qd), skipping"
+#define EM_NOSCRATCH		"all %d scratch buffers in use"
 #define EM_NOSUCHMOD		"no such module: %s"
+#define EM_OVERBUDGET		"module %s: %ld checks exceeded the read budget and were rejected"
 #define EM_SHORTBREAD		"short read near sector(%qd), %d bytes instead of %d. Skipping.."
 #define EM_BADREADIO		"read error (EIO) near sector(%qd), skipping.."
 #define EM_PINCONS		"partition still overlaps with previous one or seems invalid:"
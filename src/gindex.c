@@ -0,0 +1,432 @@
+/*
+ * gindex.c -- gpart scan index
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpart.h"
+#include "gindex.h"
+
+int idx_mode = IDX_NONE;
+
+static char *x_file;
+static unsigned long long x_fprint;
+static s64_t x_nsecs;
+static int x_ssize;
+static idx_span *x_span;
+static int x_nspan, x_maxspan;
+static idx_hit *x_hit;
+static int x_nhit, x_maxhit, x_cur;
+static byte_t *x_class;
+static s64_t x_nregions, x_region = -1, x_skipped;
+static unsigned long x_hist[256], x_hcnt;
+
+/*
+ * FNV-1a over the device size and some sectors spread
+ * evenly over the device.
+ */
+
+static unsigned long long fnv1a(unsigned long long h, byte_t *p, size_t len)
+{
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return (h);
+}
+
+static unsigned long long fingerprint(disk_desc *d)
+{
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	byte_t *buf;
+	s64_t sec;
+	int i;
+
+	buf = alloc(d->d_ssize);
+	h = fnv1a(h, (byte_t *)&d->d_nsecs, sizeof(d->d_nsecs));
+	h = fnv1a(h, (byte_t *)&d->d_ssize, sizeof(d->d_ssize));
+	for (i = 0; i < IDX_NSAMPLES; i++) {
+		sec = (d->d_nsecs - 1) / (IDX_NSAMPLES - 1) * i;
+		if (i == IDX_NSAMPLES - 1)
+			sec = d->d_nsecs - 1;
+		if ((l64seek(d->d_fd, sec * d->d_ssize, SEEK_SET) == -1) || (bread(d->d_fd, buf, d->d_ssize, 1) != d->d_ssize))
+			memset(buf, 0xff, d->d_ssize);
+		h = fnv1a(h, buf, d->d_ssize);
+	}
+	free((void *)buf);
+	return (h);
+}
+
+static void add_span(s64_t sec, unsigned long stride)
+{
+	if (x_nspan == x_maxspan) {
+		x_maxspan = x_maxspan ? 2 * x_maxspan : 64;
+		if ((x_span = (idx_span *)realloc(x_span, x_maxspan * sizeof(idx_span))) == 0)
+			pr(FATAL, EM_MALLOCFAILED, x_maxspan * sizeof(idx_span));
+	}
+	x_span[x_nspan].sp_start = x_span[x_nspan].sp_last = sec;
+	x_span[x_nspan++].sp_stride = stride;
+}
+
+static idx_hit *add_hit(s64_t sec, char *mod, float guess, s64_t size, dos_part_entry *p, int n)
+{
+	idx_hit *h;
+
+	if (x_nhit == x_maxhit) {
+		x_maxhit = x_maxhit ? 2 * x_maxhit : 64;
+		if ((x_hit = (idx_hit *)realloc(x_hit, x_maxhit * sizeof(idx_hit))) == 0)
+			pr(FATAL, EM_MALLOCFAILED, x_maxhit * sizeof(idx_hit));
+	}
+	h = &x_hit[x_nhit++];
+	memset(h, 0, sizeof(idx_hit));
+	h->h_sec = sec;
+	strncpy(h->h_mod, mod, IDX_MODNAMELEN - 1);
+	h->h_guess = guess;
+	h->h_size = size;
+	h->h_n = n;
+	memcpy(h->h_part, p, n * sizeof(dos_part_entry));
+	return (h);
+}
+
+static int cmp_span(const void *a, const void *b)
+{
+	s64_t x = ((idx_span *)a)->sp_start, y = ((idx_span *)b)->sp_start;
+
+	return ((x > y) - (x < y));
+}
+
+static int cmp_hit(const void *a, const void *b)
+{
+	idx_hit *x = (idx_hit *)a, *y = (idx_hit *)b;
+
+	if (x->h_sec != y->h_sec)
+		return ((x->h_sec > y->h_sec) - (x->h_sec < y->h_sec));
+	return (strcmp(x->h_mod, y->h_mod));
+}
+
+/*
+ * sort spans and hits, drop hits recorded twice (a guess
+ * rejected in interactive mode is evaluated again).
+ */
+
+static void sort_index()
+{
+	int i, n;
+
+	qsort(x_span, x_nspan, sizeof(idx_span), cmp_span);
+	qsort(x_hit, x_nhit, sizeof(idx_hit), cmp_hit);
+	for (i = n = 0; i < x_nhit; i++)
+		if ((n == 0) || cmp_hit(&x_hit[n - 1], &x_hit[i]))
+			x_hit[n++] = x_hit[i];
+	x_nhit = n;
+}
+
+static void classify_region()
+{
+	if ((x_region >= 0) && (x_region < x_nregions) && (x_hcnt == IDX_REGION))
+		x_class[x_region] = content_class(x_hist, x_hcnt * x_ssize);
+	x_region = -1;
+	x_hcnt = 0;
+	memset(x_hist, 0, sizeof(x_hist));
+}
+
+/*
+ * the index file is plain text:
+ *
+ *	gpart-index <version>
+ *	dev <#sectors> <sector size> <fingerprint>
+ *	span <start> <last> <stride>
+ *	hit <sector> <module|ext> <guess> <64-bit size> <entries in hex>
+ *	class <first region> <# of regions> <class>
+ *	end
+ */
+
+static void write_index()
+{
+	char tmp[1024];
+	byte_t *b;
+	idx_hit *h;
+	FILE *fp;
+	s64_t r, n;
+	int i;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", x_file);
+	if ((fp = fopen(tmp, "w")) == 0) {
+		pr(ERROR, EM_IDXWRITE, tmp, strerror(errno));
+		return;
+	}
+	fprintf(fp, "%s %d\n", IDX_MAGIC, IDX_VERSION);
+	fprintf(fp, "dev %lld %d %016llx\n", (long long)x_nsecs, x_ssize, x_fprint);
+	for (i = 0; i < x_nspan; i++)
+		fprintf(fp, "span %lld %lld %lu\n", (long long)x_span[i].sp_start, (long long)x_span[i].sp_last,
+				x_span[i].sp_stride);
+	for (h = x_hit; h < &x_hit[x_nhit]; h++) {
+		fprintf(fp, "hit %lld %s %g %lld ", (long long)h->h_sec, h->h_mod, h->h_guess, (long long)h->h_size);
+		for (b = (byte_t *)h->h_part; b < (byte_t *)&h->h_part[h->h_n]; b++)
+			fprintf(fp, "%02x", *b);
+		fprintf(fp, "\n");
+	}
+	for (r = 0; r < x_nregions; r += n) {
+		for (n = 1; (r + n < x_nregions) && (x_class[r + n] == x_class[r]); n++)
+			;
+		fprintf(fp, "class %lld %lld %d\n", (long long)r, (long long)n, x_class[r]);
+	}
+	fprintf(fp, "end\n");
+	if (fflush(fp) || ferror(fp)) {
+		pr(ERROR, EM_IDXWRITE, tmp, strerror(errno));
+		fclose(fp);
+		return;
+	}
+	fclose(fp);
+	if (rename(tmp, x_file) == -1)
+		pr(ERROR, EM_IDXWRITE, x_file, strerror(errno));
+}
+
+static int read_hit(char *line)
+{
+	dos_part_entry p[NDOSPARTS];
+	char name[IDX_MODNAMELEN], hex[2 * sizeof(p) + 1];
+	long long sec, size;
+	unsigned int b;
+	float guess;
+	int i, n;
+
+	if (sscanf(line, "hit %lld %15s %g %lld %128s", &sec, name, &guess, &size, hex) != 5)
+		return (0);
+	n = strlen(hex) / 2;
+	if ((strlen(hex) % 2) || ((n != sizeof(dos_part_entry)) && (n != sizeof(p))))
+		return (0);
+	for (i = 0; i < n; i++) {
+		sscanf(hex + 2 * i, "%2x", &b);
+		((byte_t *)p)[i] = b;
+	}
+	add_hit(sec, name, guess, size, p, n / sizeof(dos_part_entry));
+	return (1);
+}
+
+/*
+ * read the index file. Returns 1 if it was written for
+ * this device, 0 if it must be built anew.
+ */
+
+static int read_index()
+{
+	char line[512];
+	long long a, b, nsecs;
+	unsigned long long fprint;
+	unsigned long s;
+	FILE *fp;
+	int v, c, ssize, done = 0;
+
+	if ((fp = fopen(x_file, "r")) == 0) {
+		if (errno != ENOENT)
+			pr(WARN, EM_IDXREAD, x_file, strerror(errno));
+		return (0);
+	}
+	if (!fgets(line, sizeof(line), fp) || (sscanf(line, IDX_MAGIC " %d", &v) != 1) || (v != IDX_VERSION) ||
+		!fgets(line, sizeof(line), fp) || (sscanf(line, "dev %lld %d %llx", &nsecs, &ssize, &fprint) != 3)) {
+		pr(WARN, EM_IDXINVALID, x_file);
+		fclose(fp);
+		return (0);
+	}
+	if ((nsecs != x_nsecs) || (ssize != x_ssize) || (fprint != x_fprint)) {
+		pr(WARN, EM_IDXMISMATCH, x_file);
+		fclose(fp);
+		return (0);
+	}
+
+	while (!done && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "span %lld %lld %lu", &a, &b, &s) == 3) {
+			if ((s == 0) || (b < a))
+				break;
+			add_span(a, s);
+			x_span[x_nspan - 1].sp_last = b;
+		} else if (strncmp(line, "hit ", 4) == 0) {
+			if (!read_hit(line))
+				break;
+		} else if (sscanf(line, "class %lld %lld %d", &a, &b, &c) == 3) {
+			if ((a < 0) || (b < 0) || (a + b > x_nregions))
+				break;
+			memset(x_class + a, c, b);
+		} else if (strcmp(line, "end\n") == 0)
+			done = 1;
+		else
+			break;
+	}
+	fclose(fp);
+	if (!done) {
+		pr(WARN, EM_IDXINVALID, x_file);
+		x_nspan = x_nhit = 0;
+		memset(x_class, CC_UNKNOWN, x_nregions);
+		return (0);
+	}
+	sort_index();
+	return (1);
+}
+
+/*
+ * called before scanning with the device open. Consults the
+ * index file if it belongs to the device, records a new one
+ * otherwise.
+ */
+
+void idx_open(disk_desc *d, char *file)
+{
+	if (d->d_nsecs == 0) {
+		pr(WARN, EM_IDXNOSIZE, d->d_dev);
+		return;
+	}
+	x_file = file;
+	x_nsecs = d->d_nsecs;
+	x_ssize = d->d_ssize;
+	x_fprint = fingerprint(d);
+	x_nregions = (d->d_nsecs + IDX_REGION - 1) / IDX_REGION;
+	x_class = (byte_t *)alloc(x_nregions);
+	memset(x_class, CC_UNKNOWN, x_nregions);
+	idx_mode = read_index() ? IDX_CONSULT : IDX_RECORD;
+}
+
+/*
+ * called after the scan. A recorded index is written,
+ * everything is freed.
+ */
+
+void idx_close(disk_desc *d, int verbose)
+{
+	s64_t cnt[CC_DATA + 1], r;
+
+	if (idx_mode == IDX_NONE)
+		return;
+	if (idx_mode == IDX_RECORD) {
+		classify_region();
+		sort_index();
+		write_index();
+	}
+	if (verbose) {
+		memset(cnt, 0, sizeof(cnt));
+		for (r = 0; r < x_nregions; r++)
+			if (x_class[r] <= CC_DATA)
+				cnt[x_class[r]]++;
+		if (idx_mode == IDX_RECORD)
+			pr(MSG, PM_IDXWRITTEN, x_file, x_nspan, x_nhit);
+		else
+			pr(MSG, PM_IDXSKIPPED, x_file, x_skipped);
+		pr(MSG, PM_IDXCLASSES, cnt[CC_ZERO], cnt[CC_UNIFORM], cnt[CC_ENTROPY], cnt[CC_DATA], cnt[CC_UNKNOWN]);
+	}
+	if (x_span)
+		free((void *)x_span);
+	if (x_hit)
+		free((void *)x_hit);
+	free((void *)x_class);
+	x_span = 0;
+	x_hit = 0;
+	x_class = 0;
+	x_nspan = x_maxspan = x_nhit = x_maxhit = x_cur = 0;
+	idx_mode = IDX_NONE;
+}
+
+/*
+ * recording: the window at sec was read and is evaluated by
+ * all modules next, the scan continues at sec + stride if
+ * nothing is found.
+ */
+
+void idx_sector(disk_desc *d, s64_t sec, unsigned long stride)
+{
+	idx_span *sp = x_nspan ? &x_span[x_nspan - 1] : 0;
+
+	if (idx_mode != IDX_RECORD)
+		return;
+	if (sp && (sp->sp_stride == stride) && (sec == sp->sp_last + stride))
+		sp->sp_last = sec;
+	else
+		add_span(sec, stride);
+
+	/*
+	 * a region can only be classified if all of its sectors
+	 * pass by.
+	 */
+
+	if (stride != 1) {
+		classify_region();
+		return;
+	}
+	if (sec / IDX_REGION != x_region) {
+		classify_region();
+		x_region = sec / IDX_REGION;
+	}
+	byte_histogram(d->d_sbuf, d->d_ssize, x_hist);
+	x_hcnt++;
+}
+
+void idx_hit_mod(disk_desc *d, g_module *m)
+{
+	if ((idx_mode == IDX_RECORD) && (m->m_guess != GM_NO))
+		add_hit(d->d_nsb, m->m_name, m->m_guess, m->m_size, &m->m_part, 1);
+}
+
+void idx_hit_ext(disk_desc *d)
+{
+	if (idx_mode == IDX_RECORD)
+		add_hit(d->d_nsb, "ext", GM_NO, 0, (dos_part_entry *)(d->d_sbuf + DOSPARTOFF), NDOSPARTS);
+}
+
+/*
+ * consulting: the next position at or after sec (stepping
+ * by incr) which must be read. Positions evaluated before
+ * without any hit can be passed over.
+ */
+
+static idx_span *find_span(s64_t sec)
+{
+	int lo = 0, hi = x_nspan - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (x_span[mid].sp_start > sec)
+			hi = mid - 1;
+		else if (x_span[mid].sp_last < sec)
+			lo = mid + 1;
+		else
+			return (&x_span[mid]);
+	}
+	return (0);
+}
+
+s64_t idx_next(s64_t sec, unsigned long incr)
+{
+	idx_span *sp;
+	s64_t to, from = sec;
+
+	if (idx_mode != IDX_CONSULT)
+		return (sec);
+	while ((sp = find_span(sec)) && ((sec - sp->sp_start) % sp->sp_stride == 0) && (incr % sp->sp_stride == 0)) {
+		/*
+		 * scans only move forward, so do the hits
+		 */
+
+		while ((x_cur < x_nhit) && (x_hit[x_cur].h_sec < sec))
+			x_cur++;
+		to = sp->sp_last + 1;
+		if ((x_cur < x_nhit) && (x_hit[x_cur].h_sec < to))
+			to = x_hit[x_cur].h_sec;
+		if (to <= sec)
+			break;
+		sec += (to - sec + incr - 1) / incr * incr;
+	}
+	x_skipped += (sec - from) / incr;
+	return (sec);
+}
@@ -0,0 +1,71 @@
+/*
+ * gindex.h -- gpart scan index header file
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _GINDEX_H
+#define _GINDEX_H
+
+/*
+ * the scan index remembers which scan positions of a device
+ * have been evaluated by all modules and which of them gave
+ * any hit at all. A later scan of the same device only needs
+ * to read the positions with hits and those never evaluated.
+ */
+
+#define IDX_NONE	0
+#define IDX_RECORD	1		/* scanning, index is written */
+#define IDX_CONSULT	2		/* scanning with a valid index */
+
+#define IDX_MAGIC	"gpart-index"
+#define IDX_VERSION	2
+#define IDX_REGION	2048		/* sectors per classified region */
+#define IDX_NSAMPLES	16		/* sectors hashed for the fingerprint */
+#define IDX_MODNAMELEN	16
+
+/*
+ * positions sp_start, sp_start + sp_stride, ... up to and
+ * including sp_last were evaluated.
+ */
+
+typedef struct
+{
+	s64_t		sp_start;
+	s64_t		sp_last;
+	unsigned long	sp_stride;
+} idx_span;
+
+/*
+ * a raw module hit or an extended ptbl candidate
+ */
+
+typedef struct
+{
+	s64_t		h_sec;
+	char		h_mod[IDX_MODNAMELEN];
+	float		h_guess;
+	s64_t		h_size;		/* m_size */
+	int		h_n;		/* entries in h_part */
+	dos_part_entry	h_part[NDOSPARTS];
+} idx_hit;
+
+extern int idx_mode;
+
+void idx_open(disk_desc *, char *);
+void idx_close(disk_desc *, int);
+void idx_sector(disk_desc *, s64_t, unsigned long);
+void idx_hit_mod(disk_desc *, g_module *);
+void idx_hit_ext(disk_desc *);
+s64_t idx_next(s64_t, unsigned long);
+
+#endif /* _GINDEX_H */
@@ -22,11 +22,21 @@
 
 #include <stdio.h>
 
+static int beos_pfun(disk_desc *d, g_module *m)
+{
+	beos_super_block *sb = (beos_super_block *)(d->d_sbuf + 512);
+
+	return ((sb->magic1 == BEOS_SUPER_BLOCK_MAGIC1) && (sb->magic2 == BEOS_SUPER_BLOCK_MAGIC2) &&
+		(sb->magic3 == BEOS_SUPER_BLOCK_MAGIC3));
+}
+
 int beos_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "BeOS filesystem";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = beos_pfun;
 	return (2 * 512);
 }
 
@@ -17,11 +17,20 @@
 #include "gpart.h"
 #include "gm_bsddl.h"
 
+static int bsddl_pfun(disk_desc *d, g_module *m)
+{
+	struct disklabel *dl = (struct disklabel *)(d->d_sbuf + LABELSECTOR * d->d_ssize);
+
+	return ((dl->d_magic == le32(DISKMAGIC)) && (dl->d_magic2 == le32(DISKMAGIC)));
+}
+
 int bsddl_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "*BSD disklabel";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = bsddl_pfun;
 	m->m_hasptbl = 1;
 	m->m_notinext = 1;
 	return (BBSIZE);
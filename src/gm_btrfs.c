@@ -17,14 +17,32 @@
 #include <errno.h>
 #include <endian.h>
 #include "gpart.h"
+#include "crc32c.h"
 #include "gm_btrfs.h"
 
+static int btrfs_pfun(disk_desc *d, g_module *m)
+{
+	struct btrfs_super_block *sb = (struct btrfs_super_block *)(d->d_sbuf + BTRFS_SUPER_INFO_OFFSET);
+
+	return (le64toh(sb->magic) == BTRFS_MAGIC);
+}
+
+static int btrfs_cfun(disk_desc *d, g_module *m, byte_t *buf, byte_t *key)
+{
+	struct btrfs_super_block *sb_copy = (struct btrfs_super_block *)buf;
+
+	return ((le64toh(sb_copy->magic) == BTRFS_MAGIC) && (memcmp(key, sb_copy->fsid, BTRFS_FSID_SIZE) == 0));
+}
+
 int btrfs_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "Btrfs volume";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = btrfs_pfun;
+	m->m_cfun = btrfs_cfun;
 	return BTRFS_SUPER_INFO_OFFSET + BTRFS_SUPER_INFO_SIZE;
 }
 
@@ -45,16 +63,23 @@ int btrfs_gfun(disk_desc *d, g_module *m)
 	if (memcmp(sb->fsid, sb->dev_item.fsid, BTRFS_FSID_SIZE))
 		return 1;
 
+	/*
+	 * a crc32c checked super block needs no look at the mirror,
+	 * otherwise the scan may read it later.
+	 */
+
 	psize = le64toh(sb->dev_item.total_bytes);
-	if (psize > btrfs_sb_offset(1)) {
+	if ((le16toh(sb->csum_type) == BTRFS_CSUM_TYPE_CRC32) &&
+		(~crc32c(~0, (byte_t *)sb + BTRFS_CSUM_SIZE, BTRFS_SUPER_INFO_SIZE - BTRFS_CSUM_SIZE) == le32toh(*(uint32_t *)sb->csum)))
+		;
+	else if (psize > btrfs_sb_offset(1) && d->d_defer)
+		g_mod_defer(m, d->d_nsb * d->d_ssize + btrfs_sb_offset(1), sizeof(struct btrfs_super_block), sb->fsid, BTRFS_FSID_SIZE);
+	else if (psize > btrfs_sb_offset(1)) {
 		struct btrfs_super_block sb_copy;
-		if (l64seek(d->d_fd, d->d_nsb * d->d_ssize + btrfs_sb_offset(1), SEEK_SET) == -1)
-			pr(FATAL, "btrfs: cannot seek: %s", strerror(errno));
-		read(d->d_fd, &sb_copy, sizeof(sb_copy));
-		if (le64toh(sb_copy.magic) != BTRFS_MAGIC || memcmp(sb->fsid, sb_copy.fsid, BTRFS_FSID_SIZE)) {
-			pr(MSG, "btrfs: superblock copy mismatch\n");
+		if (gm_read(d, d->d_nsb * d->d_ssize + btrfs_sb_offset(1), &sb_copy, sizeof(sb_copy)) != sizeof(sb_copy))
+			memset(&sb_copy, 0, sizeof(sb_copy));
+		if (!btrfs_cfun(d, m, (byte_t *)&sb_copy, sb->fsid))
 			return 1;
-		}
 	}
 
 	m->m_guess = GM_YES;
@@ -38,6 +38,7 @@ typedef uint8_t u8;
 #define BTRFS_SUPER_MIRROR_SHIFT 12
 #define BTRFS_CSUM_SIZE 32
 #define BTRFS_FSID_SIZE 16
+#define BTRFS_CSUM_TYPE_CRC32 0
 #define BTRFS_UUID_SIZE 16
 #define BTRFS_MAGIC 0x4D5F53665248425FULL
 #define BTRFS_SYSTEM_CHUNK_ARRAY_SIZE 2048
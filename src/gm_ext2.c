@@ -22,11 +22,33 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include "gpart.h"
+#include "crc32c.h"
 #include "gm_ext2.h"
 
+static int ext2_pfun(disk_desc *d, g_module *m)
+{
+	struct ext2fs_sb *sb = (struct ext2fs_sb *)(d->d_sbuf + SUPERBLOCK_OFFSET);
+
+	return (sb->s_magic == le16(EXT2_SUPER_MAGIC));
+}
+
+/*
+ * test only some values of the spare sb.
+ */
+
+static int ext2_cfun(disk_desc *d, g_module *m, byte_t *buf, byte_t *key)
+{
+	struct ext2fs_sb *sparesb = (struct ext2fs_sb *)buf;
+
+	if (sparesb->s_magic != le16(EXT2_SUPER_MAGIC))
+		return (0);
+	return (memcmp(&sparesb->s_log_block_size, key, sizeof(sparesb->s_log_block_size)) == 0);
+}
+
 int ext2_init(disk_desc *d, g_module *m)
 {
 	int bsize = SUPERBLOCK_SIZE;
@@ -44,6 +66,9 @@ int ext2_init(disk_desc *d, g_module *m)
 		return (0);
 	}
 	m->m_desc = "Linux ext2";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = ext2_pfun;
+	m->m_cfun = ext2_cfun;
 	return (SUPERBLOCK_OFFSET + SUPERBLOCK_SIZE);
 }
 
@@ -51,22 +76,34 @@ int ext2_term(disk_desc *d) { return (1); }
 
 int ext2_gfun(disk_desc *d, g_module *m)
 {
-	struct ext2fs_sb *sb, *sparesb;
-	int psize, bsize = 1024;
-	s64_t ls, ofs;
+	struct ext2fs_sb *sb;
+	int bsize = 1024;
+	s64_t ls, ofs, blocks, fblocks;
+	uint32_t bg;
 	dos_part_entry *pt = &m->m_part;
-	byte_t *ubuf, *sbuf;
+	byte_t sbuf[SUPERBLOCK_SIZE];
 
 	m->m_guess = GM_NO;
 	sb = (struct ext2fs_sb *)(d->d_sbuf + SUPERBLOCK_OFFSET);
 	if (sb->s_magic != le16(EXT2_SUPER_MAGIC))
 		return (1);
 
+	/*
+	 * ext4 with the 64bit feature has 64 bit block counts.
+	 */
+
+	blocks = le32(sb->s_blocks_count);
+	fblocks = le32(sb->s_free_blocks_count);
+	if (le32(sb->s_feature_incompat) & EXT4_FEATURE_INCOMPAT_64BIT) {
+		blocks |= (s64_t)le32(sb->s_blocks_count_hi) << 32;
+		fblocks |= (s64_t)le32(sb->s_free_blocks_hi) << 32;
+	}
+
 	/*
 	 * first some plausability checks.
 	 */
 
-	if (sb->s_free_blocks_count >= sb->s_blocks_count)
+	if (fblocks >= blocks)
 		return (1);
 	if (sb->s_free_inodes_count >= sb->s_inodes_count)
 		return (1);
@@ -80,15 +117,24 @@ int ext2_gfun(disk_desc *d, g_module *m)
 	 * empty filesystems seem unlikely to me.
 	 */
 
-	if (sb->s_blocks_count == 0)
+	if ((blocks == 0) || (sb->s_blocks_per_group == 0))
 		return (1);
 
+	/*
+	 * ext2fs supports 1024, 2048 and 4096b blocks, ext4 up
+	 * to 64k.
+	 */
+
+	if (le32(sb->s_log_block_size) > BSIZE_65536)
+		return (1);
+	bsize = 1024 << le32(sb->s_log_block_size);
+
 	/*
 	 * yet they also shouldn't be too large.
 	 */
 
 	if (d->d_nsecs) {
-		ls = sb->s_blocks_count;
+		ls = blocks;
 		ls *= bsize;
 		ls /= d->d_ssize;
 		ls += d->d_nsb;
@@ -96,24 +142,6 @@ int ext2_gfun(disk_desc *d, g_module *m)
 			return (1);
 	}
 
-	/*
-	 * ext2fs supports 1024, 2048 and 4096b blocks.
-	 */
-
-	switch (sb->s_log_block_size) {
-	case BSIZE_1024:
-		bsize = 1024;
-		break;
-	case BSIZE_2048:
-		bsize = 2048;
-		break;
-	case BSIZE_4096:
-		bsize = 4096;
-		break;
-	default:
-		return (1);
-	}
-
 	/*
 	 * current mount count shouldn't be greater than max+20
 	 * but ext3 usually has s_max_mnt_count==-1
@@ -123,47 +151,58 @@ int ext2_gfun(disk_desc *d, g_module *m)
 		return (1);
 
 	/*
-	 * up to here this looks like a valid ext2 sb, now try to read
-	 * the first spare super block to be sure.
+	 * with metadata_csum the super block checks itself, no need
+	 * to seek.
 	 */
 
-	if ((ls = l64tell(d->d_fd)) == -1)
-		pr(FATAL, "ext2: cannot seek: %s", strerror(errno));
-	ls /= d->d_ssize;
-	ls -= d->d_nsb;
-	ls *= d->d_ssize;
-	ofs = sb->s_blocks_per_group + sb->s_first_data_block;
-	ofs *= bsize;
-	if (l64seek(d->d_fd, ofs - ls, SEEK_CUR) == -1)
-		pr(FATAL, "ext2: cannot seek: %s", strerror(errno));
-
-	psize = getpagesize();
-	ubuf = alloc(SUPERBLOCK_SIZE + psize);
-	sbuf = align(ubuf, psize);
-	if (read(d->d_fd, sbuf, SUPERBLOCK_SIZE) != SUPERBLOCK_SIZE)
-		pr(FATAL, "ext2: cannot read spare super block");
-	sparesb = (struct ext2fs_sb *)sbuf;
+	if ((le32(sb->s_feature_ro_compat) & EXT4_FEATURE_RO_COMPAT_METADATA_CSUM) &&
+		(sb->s_checksum_type == EXT4_CRC32C_CHKSUM) &&
+		(crc32c(~0, sb, offsetof(struct ext2fs_sb, s_checksum)) == le32(sb->s_checksum))) {
+		m->m_guess = GM_YES;
+		goto found;
+	}
 
 	/*
-	 * test only some values of the spare sb.
+	 * up to here this looks like a valid ext2 sb, now try to read
+	 * the first spare super block to be sure. That is in group 1
+	 * (sparse_super or not), with sparse_super2 in the first of
+	 * the two backup groups. flex_bg only moves bitmaps and inode
+	 * tables, not the spare super blocks.
 	 */
 
-	if (sparesb->s_magic != le16(EXT2_SUPER_MAGIC))
-		goto out;
-	if (sparesb->s_log_block_size != sb->s_log_block_size)
-		goto out;
+	bg = 1;
+	if (le32(sb->s_feature_compat) & EXT4_FEATURE_COMPAT_SPARSE_SUPER2)
+		if ((bg = le32(sb->s_backup_bgs[0])) == 0)
+			bg = le32(sb->s_backup_bgs[1]);
+	ofs = (s64_t)bg * le32(sb->s_blocks_per_group) + le32(sb->s_first_data_block);
+	if ((bg == 0) || (ofs >= blocks)) {
+		/*
+		 * no spare super block at all
+		 */
+
+		m->m_guess = GM_PERHAPS;
+		goto found;
+	}
+	ofs *= bsize;
+	ofs += d->d_nsb * d->d_ssize;
+	if (d->d_defer) {
+		g_mod_defer(m, ofs, SUPERBLOCK_SIZE, &sb->s_log_block_size, sizeof(sb->s_log_block_size));
+		m->m_guess = GM_YES;
+		goto found;
+	}
+	if (gm_read(d, ofs, sbuf, SUPERBLOCK_SIZE) != SUPERBLOCK_SIZE)
+		return (1);
+	if (!ext2_cfun(d, m, sbuf, (byte_t *)&sb->s_log_block_size))
+		return (1);
 
 	/*
 	 * seems ok.
 	 */
 
 	m->m_guess = GM_YES;
+found:
 	pt->p_typ = 0x83;
 	pt->p_start = d->d_nsb;
-	pt->p_size = bsize / d->d_ssize;
-	pt->p_size *= sb->s_blocks_count;
-
-out:
-	free((void *)ubuf);
+	g_mod_setsize(m, blocks * bsize / d->d_ssize);
 	return (1);
 }
@@ -38,6 +38,7 @@ typedef unsigned int __u32;
 #define BSIZE_1024		0
 #define BSIZE_2048		1
 #define BSIZE_4096		2
+#define BSIZE_65536		6		/* largest ext4 block size */
 #define EXT2_LIB_CURRENT_REV	0
 #define EXT2_SUPER_MAGIC	0xEF53
 #define EXT2_VALID_FS		0x0001		/* Unmounted cleanly */
@@ -51,6 +52,14 @@ typedef unsigned int __u32;
 #define EXT2_GOOD_OLD_REV       0       /* The good old (original) format */
 #define EXT2_DYNAMIC_REV        1       /* V2 format w/ dynamic inode sizes */
 
+/* imported from ext4 */
+
+#define EXT4_FEATURE_COMPAT_SPARSE_SUPER2	0x0200
+#define EXT4_FEATURE_INCOMPAT_64BIT		0x0080
+#define EXT4_FEATURE_INCOMPAT_FLEX_BG		0x0200
+#define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM	0x0400
+#define EXT4_CRC32C_CHKSUM			1
+
 struct ext2fs_sb {
 	__u32	s_inodes_count;		/* Inodes count */
 	__u32	s_blocks_count;		/* Blocks count */
@@ -99,7 +108,59 @@ struct ext2fs_sb {
 	__u8	s_uuid[16];		/* 128-bit uuid for volume */
 	char	s_volume_name[16]; 	/* volume name */
 	char	s_last_mounted[64]; 	/* directory where last mounted */
-	__u32	s_reserved[206];	/* Padding to the end of the block */
+	__u32	s_algorithm_usage_bitmap; /* For compression */
+	__u8	s_prealloc_blocks;	/* Nr of blocks to try to preallocate*/
+	__u8	s_prealloc_dir_blocks;	/* Nr to preallocate for dirs */
+	__u16	s_reserved_gdt_blocks;	/* Per group desc for online growth */
+	__u8	s_journal_uuid[16];	/* uuid of journal superblock */
+	__u32	s_journal_inum;		/* inode number of journal file */
+	__u32	s_journal_dev;		/* device number of journal file */
+	__u32	s_last_orphan;		/* start of list of inodes to delete */
+	__u32	s_hash_seed[4];		/* HTREE hash seed */
+	__u8	s_def_hash_version;	/* Default hash version to use */
+	__u8	s_jnl_backup_type;
+	__u16	s_desc_size;		/* size of group descriptor */
+	__u32	s_default_mount_opts;
+	__u32	s_first_meta_bg;	/* First metablock block group */
+	__u32	s_mkfs_time;		/* When the filesystem was created */
+	__u32	s_jnl_blocks[17];	/* Backup of the journal inode */
+	__u32	s_blocks_count_hi;	/* Blocks count */
+	__u32	s_r_blocks_count_hi;	/* Reserved blocks count */
+	__u32	s_free_blocks_hi;	/* Free blocks count */
+	__u16	s_min_extra_isize;	/* All inodes have at least # bytes */
+	__u16	s_want_extra_isize; 	/* New inodes should reserve # bytes */
+	__u32	s_flags;		/* Miscellaneous flags */
+	__u16	s_raid_stride;		/* RAID stride */
+	__u16	s_mmp_update_interval;	/* # seconds to wait in MMP checking */
+	__u32	s_mmp_block[2];		/* Block for multi-mount protection */
+	__u32	s_raid_stripe_width;	/* blocks on all data disks (N*stride)*/
+	__u8	s_log_groups_per_flex;	/* FLEX_BG group size */
+	__u8	s_checksum_type;	/* metadata checksum algorithm used */
+	__u8	s_encryption_level;
+	__u8	s_reserved_pad;
+	__u32	s_kbytes_written[2];	/* nr of lifetime kilobytes written */
+	__u32	s_snapshot_inum;	/* Inode number of active snapshot */
+	__u32	s_snapshot_id;		/* sequential ID of active snapshot */
+	__u32	s_snapshot_r_blocks_count[2];
+	__u32	s_snapshot_list;	/* inode number of the head of the snapshot list */
+	__u32	s_error_count;		/* number of fs errors */
+	__u32	s_first_error_time;	/* first time an error happened */
+	__u32	s_first_error_ino;	/* inode involved in first error */
+	__u32	s_first_error_block[2];	/* block involved of first error */
+	__u8	s_first_error_func[32];	/* function where the error happened */
+	__u32	s_first_error_line;	/* line number where error happened */
+	__u32	s_last_error_time;	/* most recent time of an error */
+	__u32	s_last_error_ino;	/* inode involved in last error */
+	__u32	s_last_error_line;	/* line number where error happened */
+	__u32	s_last_error_block[2];	/* block involved of last error */
+	__u8	s_last_error_func[32];	/* function where the error happened */
+	__u8	s_mount_opts[64];
+	__u32	s_usr_quota_inum;	/* inode for tracking user quota */
+	__u32	s_grp_quota_inum;	/* inode for tracking group quota */
+	__u32	s_overhead_blocks;	/* overhead blocks/clusters in fs */
+	__u32	s_backup_bgs[2];	/* groups with sparse_super2 SBs */
+	__u32	s_reserved[106];	/* Padding to the end of the block */
+	__u32	s_checksum;		/* crc32c(superblock) */
 };
 
 #endif /* _GM_EXT2_H */
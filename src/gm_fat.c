@@ -17,11 +17,15 @@
 #include "gpart.h"
 #include "gm_fat.h"
 
+static int fat_pfun(disk_desc *d, g_module *m) { return (d->d_bpb.b_fat); }
+
 int fat_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "DOS FAT";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = fat_pfun;
 	m->m_align = 'h';
 	return (sizeof(struct fat_boot_sector));
 }
@@ -30,40 +34,30 @@ int fat_term(disk_desc *d) { return (1); }
 
 int fat_gfun(disk_desc *d, g_module *m)
 {
-	struct fat_boot_sector *sb = (struct fat_boot_sector *)d->d_sbuf;
+	bpb_info *b = &d->d_bpb;
 	dos_part_entry *pt = &m->m_part;
 	unsigned long nsecs = 0;
-	unsigned char ig1, ig2, media;
 	int sectsize, fat32 = 0, fat12 = 0;
 	s64_t size = 0;
 
 	m->m_guess = GM_NO;
-	ig1 = sb->ignored[0];
-	ig2 = sb->ignored[2];
-	media = sb->media;
-	if ((ig1 == 0xeb) && (ig2 == 0x90) && ((media == 0xf8) || (media == 0xfc))) {
-		if (*((unsigned short *)d->d_sbuf + 255) != le16(DOSPTMAGIC))
-			return (1);
-
+	if (b->b_fat) {
 		/*
 		 * looks like a standard FAT boot sector. Now find out,
 		 * which one of the numerous versions this could be.
 		 */
 
 		pt->p_start = d->d_nsb;
-		nsecs = le16(sb->sectors);
-		if (nsecs == 0)
-			nsecs = le32(sb->total_sect);
-		if (nsecs == 0)
+		if ((nsecs = b->b_nsecs) == 0)
 			return (1);
-		sectsize = le16(sb->sector_size);
-		if ((d->d_sbuf[0x39] == '1') && (d->d_sbuf[0x3a] == '2'))
+		sectsize = b->b_ssize;
+		if ((b->b_fstype[3] == '1') && (b->b_fstype[4] == '2'))
 			fat12 = 1;
-		if (sb->fat_length == 0)
+		if (b->b_fatlen == 0)
 			fat32 = 1;
-		if (fat32 && (*(d->d_sbuf + 0x26) == 0x29))
+		if (fat32 && (b->b_extsig == 0x29))
 			return (1);
-		if (!fat32 && (*(d->d_sbuf + 0x26) != 0x29))
+		if (!fat32 && (b->b_extsig != 0x29))
 			return (1);
 		if (fat12 && fat32)
 			return (1);
@@ -20,12 +20,21 @@
 #include "gpart.h"
 #include "gm_hmlvm.h"
 
+static int hmlvm_pfun(disk_desc *d, g_module *m)
+{
+	pv_disk_t *pv = (pv_disk_t *)&d->d_sbuf[LVM_PV_DISK_BASE];
+
+	return (strncmp((char *)pv->id, LVM_ID, sizeof(pv->id)) == 0);
+}
+
 int hmlvm_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "Linux LVM physical volume";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = hmlvm_pfun;
 	return (LVM_PV_DISK_BASE + LVM_PV_DISK_SIZE);
 }
 
@@ -24,12 +24,16 @@
 
 #define OS2SECTSIZE 512
 
+static int hpfs_pfun(disk_desc *d, g_module *m) { return (d->d_bpb.b_hpfs); }
+
 int hpfs_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "OS/2 HPFS";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = hpfs_pfun;
 	return (OS2SECTSIZE);
 }
 
@@ -37,36 +41,24 @@ int hpfs_term(disk_desc *d) { return (1); }
 
 int hpfs_gfun(disk_desc *d, g_module *m)
 {
-	struct hpfs_boot_block *bb = (struct hpfs_boot_block *)d->d_sbuf;
+	bpb_info *b = &d->d_bpb;
 	struct hpfs_super_block *sb;
 	s64_t s;
-	size_t psize;
-	byte_t *ubuf, *sbuf;
+	byte_t sbuf[max(OS2SECTSIZE, sizeof(struct hpfs_super_block))];
 
 	m->m_guess = GM_NO;
-	if ((bb->sig_28h == 0x28) && (strncmp((char *)bb->sig_hpfs, "HPFS    ", 8) == 0) && (bb->magic == le16(0xaa55)) &&
-		(bb->bytes_per_sector == le16(OS2SECTSIZE))) {
+	if (b->b_hpfs && b->b_magic && (b->b_ssize == OS2SECTSIZE)) {
 		/*
 		 * looks like a hpfs boot sector. Test hpfs superblock
 		 * at sector offset 16 (from start of partition).
 		 */
 
-		if ((s = l64tell(d->d_fd)) == -1)
-			pr(FATAL, "hpfs: cannot seek: %s", strerror(errno));
-		s /= d->d_ssize;
-		s -= d->d_nsb;
-		s *= d->d_ssize;
-		if (l64seek(d->d_fd, 16 * OS2SECTSIZE - s, SEEK_CUR) == -1)
-			pr(FATAL, "hpfs: cannot seek: %s", strerror(errno));
-
-		psize = getpagesize();
-		ubuf = alloc(OS2SECTSIZE + psize);
-		sbuf = align(ubuf, psize);
-		if (read(d->d_fd, sbuf, OS2SECTSIZE) != OS2SECTSIZE)
-			pr(FATAL, "hpfs: cannot read super block");
+		s = d->d_nsb * d->d_ssize + 16 * OS2SECTSIZE;
+		if (gm_read(d, s, sbuf, OS2SECTSIZE) != OS2SECTSIZE)
+			return (1);
 		sb = (struct hpfs_super_block *)sbuf;
 		if (sb->magic != le32(SB_MAGIC))
-			goto out;
+			return (1);
 
 		/*
 		 * ok, fill in sizes.
@@ -78,8 +70,6 @@ int hpfs_gfun(disk_desc *d, g_module *m)
 		m->m_part.p_start = d->d_nsb;
 		m->m_part.p_size = s;
 		m->m_guess = GM_YES;
-	out:
-		free((void *)ubuf);
 	}
 	return (1);
 }
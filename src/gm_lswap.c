@@ -22,12 +22,25 @@ static char *sigs[] = {"SWAP-SPACE", "SWAPSPACE2"};
 static int pszs[] = {4096, 8192};
 static int siglen = 10;
 
+static int lswap_pfun(disk_desc *d, g_module *m)
+{
+	int i, j;
+
+	for (i = 0; i < sizeof(sigs) / sizeof(char *); i++)
+		for (j = 0; j < sizeof(pszs) / sizeof(int); j++)
+			if (strncmp((char *)(d->d_sbuf + pszs[j] - siglen), sigs[i], siglen) == 0)
+				return (1);
+	return (0);
+}
+
 int lswap_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "Linux swap";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = lswap_pfun;
 
 	/*
 	 * return the max. pagesize of platforms running Linux.
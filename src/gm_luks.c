@@ -0,0 +1,258 @@
+/*
+ * gm_luks.c -- gpart Linux LUKS encrypted volume guessing module
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gpart.h"
+#include "gm_luks.h"
+
+/*
+ * sha256 for the LUKS2 header checksum
+ */
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t *h, const byte_t *p)
+{
+	uint32_t w[64], a, b, c, d, e, f, g, k, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+	for (; i < 64; i++)
+		w[i] = w[i - 16] + (ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 7] +
+		       (ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3];
+	e = h[4]; f = h[5]; g = h[6]; k = h[7];
+	for (i = 0; i < 64; i++) {
+		t1 = k + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		k = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+/*
+ * len must be a multiple of 64, which all LUKS2 header sizes are.
+ */
+
+static void sha256(const byte_t *p, size_t len, byte_t *md)
+{
+	uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+	byte_t pad[64];
+	uint64_t bits = (uint64_t)len * 8;
+	int i;
+
+	for (; len >= 64; p += 64, len -= 64)
+		sha256_block(h, p);
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (i = 0; i < 8; i++)
+		pad[56 + i] = bits >> (56 - 8 * i);
+	sha256_block(h, pad);
+	for (i = 0; i < 32; i++)
+		md[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+static int luks_pfun(disk_desc *d, g_module *m)
+{
+	return (memcmp(d->d_sbuf, LUKS_MAGIC, LUKS_MAGIC_L) == 0);
+}
+
+int luks_init(disk_desc *d, g_module *m)
+{
+	if ((d == 0) || (m == 0))
+		return (0);
+
+	m->m_desc = "Linux LUKS encrypted volume";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = luks_pfun;
+	return (LUKS2_HDR_DEFSIZE);
+}
+
+int luks_term(disk_desc *d) { return (1); }
+
+static int luks1_check(struct luks1_phdr *ph)
+{
+	uint32_t poff, kb, ko;
+	int i;
+
+	poff = be32(ph->payloadOffset);
+	kb = be32(ph->keyBytes);
+	if ((poff * LUKS_SECTOR < sizeof(*ph)) || (be32(ph->mkDigestIterations) == 0))
+		return (0);
+	if ((kb != 16) && (kb != 32) && (kb != 48) && (kb != 64))
+		return (0);
+	if ((ph->cipherName[0] == 0) || (ph->cipherName[31] != 0) || (ph->hashSpec[31] != 0))
+		return (0);
+
+	for (i = 0; i < LUKS_NUMKEYS; i++) {
+		if ((be32(ph->keyblock[i].active) != LUKS_KEY_ENABLED) && (be32(ph->keyblock[i].active) != LUKS_KEY_DISABLED))
+			return (0);
+		ko = be32(ph->keyblock[i].keyMaterialOffset);
+		if ((ko == 0) || (ko >= poff))
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * the end in bytes of the last data segment in the json area,
+ * 0 if the json cannot be understood. A segment with a "dynamic"
+ * size extends up to the end of the underlying device, then the
+ * start of its data is returned and *dyn set.
+ */
+
+static s64_t luks2_json_end(char *json, size_t len, int *dyn)
+{
+	char *p, *e, *q;
+	s64_t end = 0, ofs, size;
+	int depth;
+
+	if (memchr(json, 0, len) == 0)
+		return (0);
+	if ((p = strstr(json, "\"segments\"")) == 0)
+		return (0);
+	if ((p = strchr(p, '{')) == 0)
+		return (0);
+
+	/*
+	 * the segments object ends at the matching brace
+	 */
+
+	for (depth = 0, e = p; *e; e++)
+		if ((*e == '{') && (depth++ == 0))
+			continue;
+		else if ((*e == '}') && (--depth == 0))
+			break;
+	if (*e == 0)
+		return (0);
+
+	while ((p = strstr(p, "\"offset\"")) && (p < e)) {
+		if ((q = strstr(p, "\"size\"")) == 0 || (q > e))
+			return (0);
+		p = strchr(p + 8, '"');
+		q = strchr(q + 6, '"');
+		if ((p == 0) || (q == 0) || (p > e) || (q > e))
+			return (0);
+		ofs = strtoll(p + 1, 0, 10);
+		if (ofs <= 0)
+			return (0);
+		if (strncmp(q + 1, "dynamic", 7) == 0) {
+			*dyn = 1;
+			return (ofs);
+		}
+		if ((size = strtoll(q + 1, 0, 10)) <= 0)
+			return (0);
+		end = max(end, ofs + size);
+		p = q + 1;
+	}
+	return (end);
+}
+
+static int luks2_check(disk_desc *d, struct luks2_hdr_disk *hd, s64_t *end, int *dyn)
+{
+	struct luks2_hdr_disk *h;
+	byte_t md[32], csum[32];
+	uint64_t hs = be64(hd->hdr_size);
+	int ret = 0;
+
+	if ((hs < LUKS2_HDR_DEFSIZE) || (hs > LUKS2_HDR_MAXSIZE) || (hs & (hs - 1)))
+		return (0);
+	if (be64(hd->hdr_offset) != 0)
+		return (0);
+	if (strncmp(hd->checksum_alg, "sha256", sizeof(hd->checksum_alg)))
+		return (0);
+
+	/*
+	 * the checksum covers the binary header with a zeroed
+	 * checksum field and the json area.
+	 */
+
+	h = (struct luks2_hdr_disk *)gm_getbuf(d, hs);
+	if (hs <= LUKS2_HDR_DEFSIZE)
+		memcpy(h, hd, hs);
+	else if (gm_read(d, d->d_nsb * d->d_ssize, h, hs) != hs)
+		goto out;
+	memcpy(csum, h->csum, sizeof(csum));
+	memset(h->csum, 0, sizeof(h->csum));
+	sha256((byte_t *)h, hs, md);
+	if (memcmp(md, csum, sizeof(md)))
+		goto out;
+
+	*end = luks2_json_end((char *)h + LUKS2_HDR_BIN_LEN, hs - LUKS2_HDR_BIN_LEN, dyn);
+	ret = (*end != 0);
+out:
+	gm_putbuf(d, (byte_t *)h);
+	return (ret);
+}
+
+int luks_gfun(disk_desc *d, g_module *m)
+{
+	struct luks1_phdr *ph;
+	dos_part_entry *pt = &m->m_part;
+	s64_t end = 0;
+	int dyn = 0;
+
+	m->m_guess = GM_NO;
+	ph = (struct luks1_phdr *)d->d_sbuf;
+	if (memcmp(ph->magic, LUKS_MAGIC, LUKS_MAGIC_L))
+		return (1);
+
+	/*
+	 * a LUKS1 or dynamic size LUKS2 volume extends up to the end
+	 * of the partition it lived in. Its size is not recorded, so
+	 * only the area up to the encrypted data is reported.
+	 */
+
+	switch (be16(ph->version)) {
+	case 1:
+		if (!luks1_check(ph))
+			return (1);
+		end = (s64_t)be32(ph->payloadOffset) * LUKS_SECTOR;
+		dyn = 1;
+		break;
+	case 2:
+		if (!luks2_check(d, (struct luks2_hdr_disk *)d->d_sbuf, &end, &dyn))
+			return (1);
+		break;
+	default:
+		return (1);
+	}
+
+	end /= d->d_ssize;
+	if (d->d_nsecs != 0 && end > d->d_nsecs - d->d_nsb)
+		return (1);
+
+	m->m_guess = dyn ? GM_PERHAPS : GM_YES;
+	pt->p_start = d->d_nsb;
+	g_mod_setsize(m, end);
+	pt->p_typ = 0xE8;
+
+	return (1);
+}
@@ -0,0 +1,75 @@
+/*
+ * gm_luks.h -- gpart Linux LUKS encrypted volume guessing module header
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _GM_LUKS_H
+#define _GM_LUKS_H
+
+/*
+ * structs & defines gathered from the LUKS1 and LUKS2 on-disk
+ * format specifications, all numbers are big endian.
+ */
+
+#define LUKS_MAGIC		"LUKS\xba\xbe"
+#define LUKS_MAGIC_L		6
+#define LUKS_SECTOR		512	/* LUKS1 offsets are in these */
+#define LUKS_NUMKEYS		8
+#define LUKS_KEY_ENABLED	0x00AC71F3
+#define LUKS_KEY_DISABLED	0x0000DEAD
+
+struct luks1_keyslot {
+	uint32_t	active;
+	uint32_t	iterations;
+	uint8_t		salt[32];
+	uint32_t	keyMaterialOffset;	/* in LUKS sectors */
+	uint32_t	stripes;
+} __attribute__((packed));
+
+struct luks1_phdr {
+	uint8_t		magic[LUKS_MAGIC_L];
+	uint16_t	version;
+	char		cipherName[32];
+	char		cipherMode[32];
+	char		hashSpec[32];
+	uint32_t	payloadOffset;		/* in LUKS sectors */
+	uint32_t	keyBytes;
+	uint8_t		mkDigest[20];
+	uint8_t		mkDigestSalt[32];
+	uint32_t	mkDigestIterations;
+	char		uuid[40];
+	struct luks1_keyslot keyblock[LUKS_NUMKEYS];
+} __attribute__((packed));
+
+#define LUKS2_HDR_BIN_LEN	4096
+#define LUKS2_HDR_DEFSIZE	16384	/* binary header and json area */
+#define LUKS2_HDR_MAXSIZE	(4 * 1024 * 1024)
+#define LUKS2_CHECKSUM_L	64
+
+struct luks2_hdr_disk {
+	uint8_t		magic[LUKS_MAGIC_L];
+	uint16_t	version;
+	uint64_t	hdr_size;		/* incl. the json area */
+	uint64_t	seqid;
+	char		label[48];
+	char		checksum_alg[32];
+	uint8_t		salt[64];
+	char		uuid[40];
+	char		subsystem[48];
+	uint64_t	hdr_offset;
+	char		_padding[184];
+	uint8_t		csum[LUKS2_CHECKSUM_L];
+	char		_padding4096[7 * 512];
+} __attribute__((packed));
+
+#endif /* _GM_LUKS_H */
@@ -18,12 +18,22 @@
 #include "gpart.h"
 #include "gm_lvm2.h"
 
+static int lvm2_pfun(disk_desc *d, g_module *m)
+{
+	struct label_header *lh = (struct label_header *)(d->d_sbuf + SECTOR_SIZE);
+
+	return ((strncmp((char *)lh->id, LABEL_ID, sizeof(lh->id)) == 0) &&
+		(strncmp((char *)lh->type, LVM2_LABEL, sizeof(lh->type)) == 0));
+}
+
 int lvm2_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "Linux LVM2 physical volume";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = lvm2_pfun;
 	return SECTOR_SIZE + LABEL_SIZE;
 }
 
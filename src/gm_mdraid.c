@@ -0,0 +1,179 @@
+/*
+ * gm_mdraid.c -- gpart Linux md RAID member guessing module
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpart.h"
+#include "gm_mdraid.h"
+
+/*
+ * both superblock versions are checksummed by adding up 32 bit
+ * words (the checksum itself as 0) and folding the carry.
+ */
+
+static uint32_t md_csum(byte_t *p, int len, int csumoff)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i + 4 <= len; i += 4)
+		sum += le32(*(uint32_t *)(p + i));
+	if (len - i == 2)
+		sum += le16(*(uint16_t *)(p + i));
+	sum -= le32(*(uint32_t *)(p + csumoff));
+	return ((uint32_t)((sum & 0xffffffff) + (sum >> 32)));
+}
+
+static int md1_check(byte_t *p)
+{
+	struct mdp_superblock_1 *sb = (struct mdp_superblock_1 *)p;
+	uint32_t md;
+
+	if ((le32(sb->magic) != MD_SB_MAGIC) || (le32(sb->major_version) != 1))
+		return (0);
+	md = le32(sb->max_dev);
+	if (MD_SB1_BYTES + md * 2 > MD_SB1_MAXBYTES)
+		return (0);
+	if ((le64(sb->data_size) == 0) || (le32(sb->raid_disks) == 0))
+		return (0);
+	return (md_csum(p, MD_SB1_BYTES + md * 2, offsetof(struct mdp_superblock_1, sb_csum)) == le32(sb->sb_csum));
+}
+
+static int md0_check(byte_t *p)
+{
+	uint32_t *w = (uint32_t *)p;
+
+	if ((le32(w[MD_SB0_MAGIC]) != MD_SB_MAGIC) || (le32(w[MD_SB0_MAJOR]) != 0) || (le32(w[MD_SB0_MINOR]) != 90))
+		return (0);
+	if ((le32(w[MD_SB0_SIZE]) == 0) || (le32(w[MD_SB0_RAID_DISKS]) == 0))
+		return (0);
+	return (md_csum(p, MD_SB0_BYTES, MD_SB0_CSUM * 4) == le32(w[MD_SB0_CSUM]));
+}
+
+static int mdraid_pfun(disk_desc *d, g_module *m)
+{
+	return ((le32(*(uint32_t *)d->d_sbuf) == MD_SB_MAGIC) ||
+		(le32(*(uint32_t *)(d->d_sbuf + MD_SB12_OFFSET * MD_SECTOR)) == MD_SB_MAGIC));
+}
+
+/*
+ * v1.0 superblocks are 4k aligned in the last 8-12k of the
+ * member and know their offset, v0.90 ones are at the last 64k
+ * aligned 64k and only know the used size of the member, which
+ * normally is all up to them.
+ */
+
+static int mdraid_efun(disk_desc *d, g_module *m, s64_t end)
+{
+	struct mdp_superblock_1 *sb;
+	s64_t endb = end * d->d_ssize, pos, start;
+	byte_t *buf;
+	int k;
+
+	m->m_guess = GM_NO;
+	for (k = 0; k < 4096; k += d->d_ssize) {
+		pos = endb - 8192 - k;
+		if (pos < d->d_nsb * d->d_ssize)
+			break;
+		sb = (struct mdp_superblock_1 *)(d->d_sbuf + (pos - d->d_nsb * d->d_ssize));
+		if (!md1_check((byte_t *)sb))
+			continue;
+		start = pos - le64(sb->super_offset) * MD_SECTOR;
+		if ((start < 0) || (start % d->d_ssize) || (((endb - start - 8192) & ~4095) != pos - start))
+			continue;
+		m->m_part.p_start = start / d->d_ssize;
+		g_mod_setsize(m, end - m->m_part.p_start);
+		m->m_part.p_typ = 0xFD;
+		m->m_guess = GM_YES;
+		return (1);
+	}
+
+	/*
+	 * the v0.90 superblock can be beyond the scan window
+	 */
+
+	if (endb < 2 * MD_RESERVED_SECTORS * MD_SECTOR)
+		return (1);
+	pos = endb - 2 * MD_RESERVED_SECTORS * MD_SECTOR;
+	buf = gm_getbuf(d, MD_RESERVED_SECTORS * MD_SECTOR + MD_SB0_BYTES);
+	if (gm_read(d, pos, buf, MD_RESERVED_SECTORS * MD_SECTOR + MD_SB0_BYTES) != MD_RESERVED_SECTORS * MD_SECTOR + MD_SB0_BYTES)
+		goto out;
+	for (k = MD_RESERVED_SECTORS * MD_SECTOR; k > 0; k -= d->d_ssize) {
+		if (!md0_check(buf + k))
+			continue;
+		start = pos + k - (s64_t)le32(((uint32_t *)(buf + k))[MD_SB0_SIZE]) * 1024;
+		if ((start < 0) || (start % d->d_ssize))
+			continue;
+		if (((endb - start) & ~65535LL) - 65536 != pos + k - start)
+			continue;
+		m->m_part.p_start = start / d->d_ssize;
+		g_mod_setsize(m, end - m->m_part.p_start);
+		m->m_part.p_typ = 0xFD;
+		m->m_guess = GM_YES;
+		break;
+	}
+out:
+	gm_putbuf(d, buf);
+	return (1);
+}
+
+int mdraid_init(disk_desc *d, g_module *m)
+{
+	if ((d == 0) || (m == 0))
+		return (0);
+
+	m->m_desc = "Linux md RAID member";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = mdraid_pfun;
+	m->m_efun = mdraid_efun;
+	return (MD_SB12_OFFSET * MD_SECTOR + MD_SB1_MAXBYTES);
+}
+
+int mdraid_term(disk_desc *d) { return (1); }
+
+int mdraid_gfun(disk_desc *d, g_module *m)
+{
+	struct mdp_superblock_1 *sb;
+	dos_part_entry *pt = &m->m_part;
+	s64_t size;
+	int i;
+
+	/*
+	 * v1.1 at the start, v1.2 4k after it. The member extends
+	 * up to the end of its data.
+	 */
+
+	m->m_guess = GM_NO;
+	for (i = 0; i <= MD_SB12_OFFSET; i += MD_SB12_OFFSET) {
+		sb = (struct mdp_superblock_1 *)(d->d_sbuf + i * MD_SECTOR);
+		if (!md1_check((byte_t *)sb) || (le64(sb->super_offset) != i))
+			continue;
+		if (le64(sb->data_offset) < i + MD_SB1_MAXBYTES / MD_SECTOR)
+			continue;
+		size = le64(sb->data_offset) + le64(sb->data_size);
+		size = size * MD_SECTOR / d->d_ssize;
+		if (d->d_nsecs != 0 && size > d->d_nsecs - d->d_nsb)
+			continue;
+
+		m->m_guess = GM_YES;
+		pt->p_start = d->d_nsb;
+		g_mod_setsize(m, size);
+		pt->p_typ = 0xFD;
+		break;
+	}
+	return (1);
+}
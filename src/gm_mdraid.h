@@ -0,0 +1,92 @@
+/*
+ * gm_mdraid.h -- gpart Linux md RAID member guessing module header
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _GM_MDRAID_H
+#define _GM_MDRAID_H
+
+/*
+ * structs & defines gathered from linux/raid/md_p.h. All
+ * offsets and sizes are in 512 byte sectors.
+ */
+
+#define MD_SB_MAGIC		0xa92b4efc
+#define MD_SECTOR		512
+
+/*
+ * v0.90, at the last 64k aligned 64k of the member, host
+ * byte order (little endian here). Only the words used.
+ */
+
+#define MD_RESERVED_SECTORS	128
+#define MD_SB0_BYTES		4096
+#define MD_SB0_WORDS		(MD_SB0_BYTES / 4)
+
+#define MD_SB0_MAGIC		0
+#define MD_SB0_MAJOR		1
+#define MD_SB0_MINOR		2
+#define MD_SB0_SIZE		8	/* used size of the member in kb */
+#define MD_SB0_RAID_DISKS	10
+#define MD_SB0_CSUM		38
+
+/*
+ * v1.x, little endian. v1.0 is at the end of the member, v1.1
+ * at its start and v1.2 4k after it.
+ */
+
+#define MD_SB1_BYTES		256
+#define MD_SB1_MAXBYTES		4096
+#define MD_SB12_OFFSET		8
+
+struct mdp_superblock_1 {
+	uint32_t	magic;
+	uint32_t	major_version;
+	uint32_t	feature_map;
+	uint32_t	pad0;
+	uint8_t		set_uuid[16];
+	char		set_name[32];
+	uint64_t	ctime;
+	uint32_t	level;
+	uint32_t	layout;
+	uint64_t	size;
+	uint32_t	chunksize;
+	uint32_t	raid_disks;
+	uint32_t	bitmap_offset;
+	uint32_t	new_level;
+	uint64_t	reshape_position;
+	uint32_t	delta_disks;
+	uint32_t	new_layout;
+	uint32_t	new_chunk;
+	uint32_t	new_offset;
+	uint64_t	data_offset;
+	uint64_t	data_size;
+	uint64_t	super_offset;
+	uint64_t	recovery_offset;
+	uint32_t	dev_number;
+	uint32_t	cnt_corrected_read;
+	uint8_t		device_uuid[16];
+	uint8_t		devflags;
+	uint8_t		bblog_shift;
+	uint16_t	bblog_size;
+	uint32_t	bblog_offset;
+	uint64_t	utime;
+	uint64_t	events;
+	uint64_t	resync_offset;
+	uint32_t	sb_csum;
+	uint32_t	max_dev;
+	uint8_t		pad3[32];
+	uint16_t	dev_roles[0];
+} __attribute__((packed));
+
+#endif /* _GM_MDRAID_H */
@@ -17,11 +17,21 @@
 #include "gpart.h"
 #include "gm_minix.h"
 
+static int minix_pfun(disk_desc *d, g_module *m)
+{
+	struct minix_super_block *ms = (struct minix_super_block *)(d->d_sbuf + BLOCK_SIZE);
+
+	return ((ms->s_magic == le16(MINIX_SUPER_MAGIC)) || (ms->s_magic == le16(MINIX_SUPER_MAGIC2)) ||
+		(ms->s_magic == le16(MINIX2_SUPER_MAGIC)) || (ms->s_magic == le16(MINIX2_SUPER_MAGIC2)));
+}
+
 int minix_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "Minix filesystem";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = minix_pfun;
 	return (2 * BLOCK_SIZE);
 }
 
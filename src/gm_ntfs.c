@@ -23,12 +23,63 @@
 
 #define NTFS_SECTSIZE 512
 
+static int ntfs_pfun(disk_desc *d, g_module *m) { return (d->d_bpb.b_ntfs); }
+
+/*
+ * the sector count of an ntfs boot sector, -1 if it isn't one.
+ * ntfs detection is quite weak, should come before fat or hpfs.
+ */
+
+static s64_t ntfs_size(bpb_info *b)
+{
+	int mft_clusters_per_record;
+
+	if (!b->b_ntfs || (b->b_mftcl > 256UL) || (b->b_idxcl > 256UL))
+		return (-1);
+	mft_clusters_per_record = (int8_t)b->b_mftcl;
+	if ((mft_clusters_per_record < 0) && (mft_clusters_per_record != -10))
+		return (-1);
+	return (b->b_nsecs64);
+}
+
+/*
+ * the backup boot sector is the last sector of the volume, right
+ * after the sectors counted in the boot sector. It still tells
+ * where the volume starts if the primary boot sector is lost.
+ */
+
+static int ntfs_efun(disk_desc *d, g_module *m, s64_t end)
+{
+	byte_t *bs = d->d_sbuf + (end - 1 - d->d_nsb) * d->d_ssize;
+	byte_t sbuf[NTFS_SECTSIZE];
+	bpb_info b;
+	s64_t size;
+
+	m->m_guess = GM_NO;
+	bpb_decode(bs, &b);
+	size = ntfs_size(&b);
+	if ((size <= 0) || (size >= end))
+		return (1);
+
+	m->m_part.p_start = end - 1 - size;
+	m->m_part.p_size = (unsigned long)size + 1;
+	m->m_part.p_typ = 0x07;
+	m->m_guess = GM_PERHAPS;
+	if ((gm_read(d, m->m_part.p_start * d->d_ssize, sbuf, NTFS_SECTSIZE) == NTFS_SECTSIZE) &&
+		(memcmp(bs, sbuf, NTFS_SECTSIZE) == 0))
+		m->m_guess = GM_YES;
+	return (1);
+}
+
 int ntfs_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "Windows NT/W2K FS";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = ntfs_pfun;
+	m->m_efun = ntfs_efun;
 	m->m_hasptbl = 1;
 	return (NTFS_SECTSIZE); /* The ntfs driver in Linux just assumes so */
 }
@@ -37,27 +88,11 @@ int ntfs_term(disk_desc *d) { return (1); }
 
 int ntfs_gfun(disk_desc *d, g_module *m)
 {
-	int mft_clusters_per_record;
 	s64_t size, ls;
-	byte_t *ubuf, *sbuf;
+	byte_t sbuf[NTFS_SECTSIZE];
 
 	m->m_guess = GM_NO;
-	if (IS_NTFS_VOLUME(d->d_sbuf)) {
-		/*
-		 * ntfs detection is quite weak, should come before
-		 * fat or hpfs.
-		 */
-
-		if (NTFS_GETU32(d->d_sbuf + 0x40) > 256UL)
-			return (1);
-		if (NTFS_GETU32(d->d_sbuf + 0x44) > 256UL)
-			return (1);
-
-		mft_clusters_per_record = NTFS_GETS8(d->d_sbuf + 0x40);
-		if ((mft_clusters_per_record < 0) && (mft_clusters_per_record != -10))
-			return (1);
-		size = NTFS_GETU64(d->d_sbuf + 0x28);
-
+	if ((size = ntfs_size(&d->d_bpb)) >= 0) {
 		/*
 		 * look for an additional backup boot sector at the end of
 		 * this FS (NT4 puts this backup sector after the FS, this
@@ -66,15 +101,8 @@ int ntfs_gfun(disk_desc *d, g_module *m)
 
 		ls = d->d_nsb + size;
 		ls *= d->d_ssize;
-		if (l64seek(d->d_fd, ls, SEEK_SET) >= 0) {
-			ubuf = alloc(NTFS_SECTSIZE + getpagesize());
-			sbuf = align(ubuf, getpagesize());
-			if (read(d->d_fd, sbuf, NTFS_SECTSIZE) != NTFS_SECTSIZE)
-				pr(FATAL, "ntfs: cannot read backup boot sector");
-			if (memcmp(d->d_sbuf, sbuf, NTFS_SECTSIZE) == 0)
-				size += 1;
-			free((void *)ubuf);
-		}
+		if ((gm_read(d, ls, sbuf, NTFS_SECTSIZE) == NTFS_SECTSIZE) && (memcmp(d->d_sbuf, sbuf, NTFS_SECTSIZE) == 0))
+			size += 1;
 
 		m->m_part.p_start = d->d_nsb;
 		m->m_part.p_size = (unsigned long)size;
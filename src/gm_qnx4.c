@@ -22,11 +22,18 @@
 
 #include <stdio.h>
 
+static int qnx4_pfun(disk_desc *d, g_module *m)
+{
+	return (memcmp(d->d_sbuf + 4, QNX4_BOOTSECT_SIG, strlen(QNX4_BOOTSECT_SIG)) == 0);
+}
+
 int qnx4_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "QNX4 filesystem";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = qnx4_pfun;
 	m->m_notinext = 1;
 	return (2 * QNX4_BLOCK_SIZE);
 }
@@ -37,9 +44,9 @@ int qnx4_gfun(disk_desc *d, g_module *m)
 {
 	struct qnx4_super_block *sb;
 	struct qnx4_inode_entry *rootdir, bitmap;
-	int rd, rl, i, j, psize, found;
-	s64_t ls, ofs, size;
-	byte_t *ubuf, *sbuf;
+	int rd, rl, i, j, found;
+	s64_t ofs, size;
+	byte_t sbuf[QNX4_BLOCK_SIZE];
 
 	m->m_guess = GM_NO;
 
@@ -57,27 +64,24 @@ int qnx4_gfun(disk_desc *d, g_module *m)
 	 * read root directory
 	 */
 
-	psize = getpagesize();
-	ubuf = alloc(QNX4_BLOCK_SIZE + psize);
-	sbuf = align(ubuf, psize);
-
 	found = 0;
 
 	rd = le32(sb->RootDir.di_first_xtnt.xtnt_blk) - 1;
 	rl = le32(sb->RootDir.di_first_xtnt.xtnt_size);
+	if ((rd < 0) || (rl <= 0))
+		return (1);
+
+	/*
+	 * the extent size is not trusted, the read budget ends
+	 * the loop on garbage.
+	 */
 
 	for (j = 0; j < rl; j++) {
-		if ((ls = l64tell(d->d_fd)) == -1)
-			pr(FATAL, "qnx4: cannot seek: %s", strerror(errno));
-		ls /= d->d_ssize;
-		ls -= d->d_nsb;
-		ls *= d->d_ssize;
 		ofs = rd + j;
 		ofs *= QNX4_BLOCK_SIZE;
-		if (l64seek(d->d_fd, ofs - ls, SEEK_CUR) == -1)
-			pr(FATAL, "qnx4: cannot seek: %s", strerror(errno));
-		if (read(d->d_fd, sbuf, QNX4_BLOCK_SIZE) != QNX4_BLOCK_SIZE)
-			pr(FATAL, "qnx4: cannot read root dir entry");
+		ofs += d->d_nsb * d->d_ssize;
+		if (gm_read(d, ofs, sbuf, QNX4_BLOCK_SIZE) != QNX4_BLOCK_SIZE)
+			return (1);
 
 		/*
 		 * find the ".bitmap" entry
@@ -85,7 +89,7 @@ int qnx4_gfun(disk_desc *d, g_module *m)
 
 		for (i = 0; i < QNX4_INODES_PER_BLOCK; i++) {
 			rootdir = (struct qnx4_inode_entry *)(sbuf + i * QNX4_DIR_ENTRY_SIZE);
-			if (rootdir->di_fname && !strncmp(rootdir->di_fname, QNX4_BITMAP_NAME, strlen(QNX4_BITMAP_NAME))) {
+			if (*rootdir->di_fname && !strncmp(rootdir->di_fname, QNX4_BITMAP_NAME, strlen(QNX4_BITMAP_NAME))) {
 				memcpy(&bitmap, rootdir, sizeof(struct qnx4_inode_entry));
 				found = 1;
 			}
@@ -104,6 +108,5 @@ int qnx4_gfun(disk_desc *d, g_module *m)
 	m->m_part.p_start = d->d_nsb;
 	m->m_part.p_size = size;
 
-	free((void *)ubuf);
 	return (1);
 }
@@ -22,12 +22,23 @@
 #include "gpart.h"
 #include "gm_reiserfs.h"
 
+static int reiserfs_pfun(disk_desc *d, g_module *m)
+{
+	struct reiserfs_super_block_v35 *sb;
+
+	sb = (struct reiserfs_super_block_v35 *)(d->d_sbuf + REISERFS_FIRST_BLOCK * 1024);
+	return ((strncmp(sb->s_magic, REISERFS_SUPER_V35_MAGIC, 12) == 0) ||
+		(strncmp(sb->s_magic, REISERFS_SUPER_V36_MAGIC, 12) == 0));
+}
+
 int reiserfs_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "ReiserFS filesystem";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = reiserfs_pfun;
 	return (REISERFS_FIRST_BLOCK * 1024 + SB_V35_SIZE);
 }
 
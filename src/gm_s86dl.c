@@ -17,11 +17,20 @@
 #include "gpart.h"
 #include "gm_s86dl.h"
 
+static int s86dl_pfun(disk_desc *d, g_module *m)
+{
+	struct solaris_x86_vtoc *svtoc = (struct solaris_x86_vtoc *)(d->d_sbuf + 512);
+
+	return ((svtoc->v_sanity == SOLARIS_X86_VTOC_SANE) && (svtoc->v_version == SOLARIS_X86_V_VERSION));
+}
+
 int s86dl_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 	m->m_desc = "Solaris/x86 disklabel";
+	m->m_maxguess = GM_YES;
+	m->m_pfun = s86dl_pfun;
 	m->m_notinext = 1;
 	return (512 + sizeof(struct solaris_x86_vtoc));
 }
@@ -15,20 +15,49 @@
  */
 
 #include <string.h>
+#include <stddef.h>
 #include "gpart.h"
+#include "crc32c.h"
 #include "gm_xfs.h"
 
+static int xfs_pfun(disk_desc *d, g_module *m)
+{
+	xfs_sb_t *sb = (xfs_sb_t *)d->d_sbuf;
+
+	return (be32(sb->sb_magicnum) == XFS_SB_MAGIC);
+}
+
 int xfs_init(disk_desc *d, g_module *m)
 {
 	if ((d == 0) || (m == 0))
 		return (0);
 
 	m->m_desc = "SGI XFS filesystem";
-	return (512);
+	m->m_maxguess = GM_YES;
+	m->m_pfun = xfs_pfun;
+	return (XFS_SB_MAXSECT);
 }
 
 int xfs_term(disk_desc *d) { return (1); }
 
+/*
+ * v5 superblocks carry a crc32c of their sector, taken with
+ * sb_crc as zero.
+ */
+
+static int xfs_crc_ok(xfs_sb_t *sb)
+{
+	uint32_t c, zero = 0;
+	int ofs = offsetof(xfs_sb_t, sb_crc), len = be16(sb->sb_sectsize);
+
+	if ((len < sizeof(xfs_sb_t)) || (len > XFS_SB_MAXSECT))
+		return (0);
+	c = crc32c(~0, sb, ofs);
+	c = crc32c(c, &zero, sizeof(zero));
+	c = crc32c(c, (byte_t *)sb + ofs + sizeof(zero), len - ofs - sizeof(zero));
+	return (~c == le32(sb->sb_crc));
+}
+
 int xfs_gfun(disk_desc *d, g_module *m)
 {
 	xfs_sb_t *sb;
@@ -62,6 +91,8 @@ int xfs_gfun(disk_desc *d, g_module *m)
 	size /= d->d_ssize;
 
 	m->m_guess = GM_YES;
+	if ((be16(sb->sb_versionnum) & XFS_SB_VERSION_NUMBITS) == XFS_SB_VERSION_5 && !xfs_crc_ok(sb))
+		m->m_guess = GM_PERHAPS;
 	m->m_part.p_start = d->d_nsb;
 	m->m_part.p_size = (unsigned long)size;
 	m->m_part.p_typ = 0x83;
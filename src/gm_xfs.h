@@ -79,6 +79,9 @@ typedef struct {
 #define	XFS_SB_VERSION_2	2		/* 6.2 - attributes */
 #define	XFS_SB_VERSION_3	3		/* 6.2 - new inode version */
 #define	XFS_SB_VERSION_4	4		/* 6.2+ - bitmask version */
+#define	XFS_SB_VERSION_5	5		/* crc protected metadata */
+#define	XFS_SB_VERSION_NUMBITS	0x000f
+#define	XFS_SB_MAXSECT		4096		/* largest sb sector checked */
 
 /*
  * Inode minimum and maximum sizes.
@@ -140,7 +143,17 @@ typedef struct xfs_sb
 	__u32		sb_unit;	/* stripe or raid unit */
 	__u32		sb_width;	/* stripe or raid width */	
 	__u8		sb_dirblklog;	/* log2 of dir block size (fsbs) */
-        __u8		sb_dummy[7];    /* padding */
+	__u8		sb_logsectlog;	/* log2 of the log sector size */
+	__u16		sb_logsectsize;	/* sector size for the log, bytes */
+	__u32		sb_logsunit;	/* stripe unit size for the log */
+	__u32		sb_features2;	/* additional feature bits */
+	__u32		sb_bad_features2;
+	/* version 5 superblock fields start here */
+	__u32		sb_features_compat;
+	__u32		sb_features_ro_compat;
+	__u32		sb_features_incompat;
+	__u32		sb_features_log_incompat;
+	__u32		sb_crc;		/* superblock crc, little endian */
 } xfs_sb_t;
 
 #endif /* _GM_XFS_H */
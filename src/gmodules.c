@@ -82,6 +82,52 @@ g_module *g_mod_setweight(char *name, float weight)
 	return (g_head);
 }
 
+/*
+ * reorder the list, cmp like for qsort. The sort is stable.
+ */
+
+void g_mod_sort(int (*cmp)(g_module *, g_module *))
+{
+	g_module *m, *next, **mp, *sorted = 0;
+
+	for (m = g_head; m; m = next) {
+		next = m->m_next;
+		for (mp = &sorted; *mp && ((*cmp)(*mp, m) <= 0); mp = &(*mp)->m_next)
+			;
+		m->m_next = *mp;
+		*mp = m;
+	}
+	g_head = sorted;
+}
+
+/*
+ * partition entries only hold 32 bit sizes. Modules set larger
+ * sizes with g_mod_setsize(), the scan takes them from g_mod_size().
+ */
+
+void g_mod_setsize(g_module *m, s64_t size)
+{
+	m->m_part.p_size = (size > 0xFFFFFFFFLL) ? 0xFFFFFFFF : (uint32_t)size;
+	m->m_size = (size > 0xFFFFFFFFLL) ? size : 0;
+}
+
+s64_t g_mod_size(g_module *m) { return (m->m_size ? m->m_size : m->m_part.p_size); }
+
+/*
+ * a module which has a guess but wants to confirm it by a read
+ * away from the scan window can leave that read to the scan if
+ * d->d_defer is set. Its m_cfun then gets the len bytes from
+ * ofs and the key later, and says whether the guess holds.
+ */
+
+void g_mod_defer(g_module *m, s64_t ofs, int len, void *key, int klen)
+{
+	m->m_cfofs = ofs;
+	m->m_cflen = len;
+	memset(m->m_cfkey, 0, GM_CFKEYLEN);
+	memcpy(m->m_cfkey, key, min(klen, GM_CFKEYLEN));
+}
+
 g_module *g_mod_lookup(int how, char *name)
 {
 	g_module *m;
@@ -92,9 +138,12 @@ g_module *g_mod_lookup(int how, char *name)
 		g_head = (g_module *)alloc(sizeof(g_module));
 		m = g_head;
 	} else {
-		for (m = g_head; m->m_next; m = m->m_next)
+		for (m = g_head;; m = m->m_next) {
 			if (strcmp(m->m_name, name) == 0)
 				return (m);
+			if (m->m_next == 0)
+				break;
+		}
 		if (how == GM_LOOKUP)
 			return (0);
 		m->m_next = (g_module *)alloc(sizeof(g_module));
@@ -103,6 +152,7 @@ g_module *g_mod_lookup(int how, char *name)
 	if ((m->m_name = strdup(name)) == 0)
 		pr(FATAL, "out of memory in strdup");
 	m->m_weight = 1.0;
+	m->m_maxguess = GM_UNDOUBTEDLY;
 	g_count++;
 	return (m);
 }
@@ -24,6 +24,8 @@
 #define GM_YES		(0.8)
 #define GM_UNDOUBTEDLY	(1.0)
 
+#define GM_CFKEYLEN	16		/* key of a deferred confirmation */
+
 typedef struct g_mod
 {
 	char		*m_name;	/* name of module */
@@ -31,10 +33,25 @@ typedef struct g_mod
 	int		(*m_init)(disk_desc *,struct g_mod *);
 	int		(*m_term)(disk_desc *);
 	int		(*m_gfun)(disk_desc *,struct g_mod *);
+	int		(*m_pfun)(disk_desc *,struct g_mod *);	/* magic test only, optional */
+	int		(*m_efun)(disk_desc *,struct g_mod *,s64_t);	/* end probe, optional */
+	int		(*m_cfun)(disk_desc *,struct g_mod *,byte_t *,byte_t *); /* deferred confirmation, optional */
 	float		m_guess;
 	float		m_weight;	/* probability weight */
+	float		m_maxguess;	/* highest m_guess it reports */
 	dos_part_entry	m_part;		/* a guessed partition entry */
+	s64_t		m_size;		/* its size if p_size overflows */
+	s64_t		m_cfofs;	/* confirm by reading there (bytes) */
+	int		m_cflen;	/* that many bytes, 0: confirmed */
+	byte_t		m_cfkey[GM_CFKEYLEN]; /* what m_cfun compares */
 	long		m_align;	/* alignment of partition */
+	long		m_overbudget;	/* checks rejected, read budget exceeded */
+	int		m_order;	/* list position when the scan started */
+	s64_t		m_calls;	/* checks done */
+	s64_t		m_hits;		/* of them with a guess */
+	s64_t		m_ns;		/* time spent in the timed ones */
+	s64_t		m_timed;
+	s64_t		m_saved;	/* checks left out, already decided */
 	struct g_mod	*m_next;
 	unsigned int	m_hasptbl : 1;	/* has a ptbl like entry in sec 0 */
 	unsigned int	m_notinext : 1;	/* cannot exist in an ext part. */
@@ -49,6 +66,10 @@ g_module *g_mod_head(), *g_mod_lookup(int,char *);
 void g_mod_addinternals();
 int g_mod_count();
 g_module *g_mod_setweight(char *,float);
+void g_mod_setsize(g_module *,s64_t);
+s64_t g_mod_size(g_module *);
+void g_mod_defer(g_module *,s64_t,int,void *,int);
+void g_mod_sort(int (*)(g_module *,g_module *));
 
 
 
@@ -71,6 +92,8 @@ g_module *g_mod_setweight(char *,float);
 	G_MODULE(s86dl) \
 	G_MODULE(hmlvm) \
 	G_MODULE(lvm2) \
+	G_MODULE(luks) \
+	G_MODULE(mdraid) \
 	G_MODULE(xfs)
 
 #define G_MODULE(mod)	int mod##_init(disk_desc *,g_module *),	\
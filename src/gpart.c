@@ -53,18 +53,32 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "gpart.h"
+#include "gindex.h"
+#include "gpt.h"
+#include "gtrace.h"
+#include "bcache.h"
 
 static const char *gpart_version = PACKAGE_NAME " v" VERSION;
 
 int f_check = 0, f_verbose = 0, f_dontguess = 0, f_fast = 1;
 int f_getgeom = 1, f_interactive = 0, f_quiet = 0, f_testext = 1;
-int f_skiperrors = 1, berrno = 0;
+int f_skiperrors = 1, f_backfill = 0, berrno = 0;
 int (*boundary_fun)(disk_desc *, s64_t);
-unsigned long increment = 's', gc = 0, gh = 0, gs = 0;
-s64_t skipsec = 0, maxsec = 0;
+unsigned long increment = 's', bfincrement = 0, entincrement = 0, gc = 0, gh = 0, gs = 0;
+s64_t skipsec = 0, maxsec = 0, *probes = 0;
+int nprobes = 0, maxprobes = 0, f_resume = 0, f_replay = 0;
+int f_shard = 0, f_merge = 0, f_endprobe = 0, f_gpt = 1, f_entskip = 0, f_defer = 0;
+long ckinterval = 60;
+char *ckfile = 0, *idxfile = 0, *trcfile = 0, *rdev = 0;
+long deadline = 0, survey = 0, bcmb = BC_DEFMB, rbkb = RB_DEFKB, rbms = RB_DEFMS;
+time_t dl_end = 0;
+int dl_expired = 0;
 FILE *logfile = 0;
 
 void usage()
@@ -72,10 +86,18 @@ void usage()
 	FILE *fp = stderr;
 
 	fprintf(fp, "Usage: %s [options] device\n", PACKAGE_NAME);
+	fprintf(fp, "       %s [options] --replay <trace file>\n", PACKAGE_NAME);
+	fprintf(fp, "       %s [options] --merge <shard file> ...\n", PACKAGE_NAME);
 	fprintf(fp, "Options: [-b <backup MBR>][-C c,h,s][-c][-d][-E][-e][-f][-g][-h][-i]\n");
 	fprintf(fp, "         [-K <last sector>][-k <# of sectors>][-L][-l <log file>]\n");
 	fprintf(fp, "         [-n <increment>][-q][-s <sector-size>]\n");
 	fprintf(fp, "         [-V][-v][-W <device>][-w <module-name,weight>]\n");
+	fprintf(fp, "         [--backfill[=<increment>]][--probe <sector,...|@file>]\n");
+	fprintf(fp, "         [--checkpoint <file>][--checkpoint-interval <seconds>][--resume]\n");
+	fprintf(fp, "         [--index <file>][--trace <file>][--shard <file>][--device <device>]\n");
+	fprintf(fp, "         [--deadline <seconds>][--survey[=<windows>]][--end-probes][--no-gpt]\n");
+	fprintf(fp, "         [--skip-entropy[=<increment>]][--cache <mb>][--defer]\n");
+	fprintf(fp, "         [--read-budget <kb>][--time-budget <ms>]\n");
 	fprintf(fp, "%s (c) 1999-2001 Michail Brzitwa <michail@brzitwa.de>.\n", gpart_version);
 	fprintf(fp, "Guess PC-type hard disk partitions.\n\n");
 	fprintf(fp, "Options:\n");
@@ -93,13 +115,59 @@ void usage()
 	fprintf(fp, " -k  Skip sectors before scan.\n");
 	fprintf(fp, " -L  List available modules and their weights, then exit.\n");
 	fprintf(fp, " -l  Logfile name.\n");
-	fprintf(fp, " -n  Scan increment: number or 's' sector, 'h' head, 'c' cylinder.\n");
+	fprintf(fp, " -n  Scan increment: number or 's' sector, 'h' head, 'c' cylinder,\n");
+	fprintf(fp, "     'a' adaptive (sectors screened by the module prefilters).\n");
 	fprintf(fp, " -q  Run quiet (however log file is written if specified).\n");
 	fprintf(fp, " -s  Sector size to use (disable sector size probing).\n");
 	fprintf(fp, " -V  Show version.\n");
 	fprintf(fp, " -v  Verbose mode. Can be given more than once.\n");
 	fprintf(fp, " -W  Write guessed primary partition table to given device or file.\n");
 	fprintf(fp, " -w  Weight factor of module.\n");
+	fprintf(fp, " --backfill\n");
+	fprintf(fp, "     Rescan ranges skipped by the fast scan at the given increment\n");
+	fprintf(fp, "     (default 1mb boundaries).\n");
+	fprintf(fp, " --probe\n");
+	fprintf(fp, "     Only investigate the given sectors (list or file) instead of scanning.\n");
+	fprintf(fp, " --checkpoint\n");
+	fprintf(fp, "     Periodically save the scan state to the given file.\n");
+	fprintf(fp, " --checkpoint-interval\n");
+	fprintf(fp, "     Seconds between two checkpoints (default 60).\n");
+	fprintf(fp, " --resume\n");
+	fprintf(fp, "     Continue the scan saved in the checkpoint file.\n");
+	fprintf(fp, " --index\n");
+	fprintf(fp, "     Record the scan in an index file, or skip the sectors known\n");
+	fprintf(fp, "     from an index written before for the same device.\n");
+	fprintf(fp, " --trace\n");
+	fprintf(fp, "     Record the raw module results of the scan in a trace file.\n");
+	fprintf(fp, " --replay\n");
+	fprintf(fp, "     Scan the trace file instead of a device.\n");
+	fprintf(fp, " --shard\n");
+	fprintf(fp, "     Scan the -k/-K range as part of a sharded scan, save it to the file.\n");
+	fprintf(fp, " --merge\n");
+	fprintf(fp, "     Scan the shard files as one device.\n");
+	fprintf(fp, " --device\n");
+	fprintf(fp, "     Read what is missing in the trace or shards from the device.\n");
+	fprintf(fp, " --deadline\n");
+	fprintf(fp, "     Scan the most likely places first, stop after the given seconds.\n");
+	fprintf(fp, " --survey\n");
+	fprintf(fp, "     Only sample the given number of windows (default 4096), print the\n");
+	fprintf(fp, "     estimated layout and the time a full scan would take.\n");
+	fprintf(fp, " --end-probes\n");
+	fprintf(fp, "     After the scan look for backup structures at the end of the disk\n");
+	fprintf(fp, "     and before each partition found.\n");
+	fprintf(fp, " --no-gpt\n");
+	fprintf(fp, "     Don't seed the scan from a valid GPT.\n");
+	fprintf(fp, " --skip-entropy\n");
+	fprintf(fp, "     Probe high entropy (encrypted, compressed) areas only at the given\n");
+	fprintf(fp, "     increment (default 1mb boundaries).\n");
+	fprintf(fp, " --cache\n");
+	fprintf(fp, "     Size in mb of the cache for reads of the modules (default 4, 0: none).\n");
+	fprintf(fp, " --defer\n");
+	fprintf(fp, "     Confirm guesses by their spare structures later, in offset order.\n");
+	fprintf(fp, " --read-budget\n");
+	fprintf(fp, "     Kb a module may read to check one position (default 16384, 0: any).\n");
+	fprintf(fp, " --time-budget\n");
+	fprintf(fp, "     Ms a module may read to check one position (default 0: any).\n");
 	fprintf(fp, "\n");
 }
 
@@ -311,6 +379,7 @@ static char *get_part_type(int type)
 				  {0xE1, "SpeedStor 12-bit FAT extended"},
 				  {0xE3, "Speed"},
 				  {0xE4, "SpeedStor 16-bit FAT"},
+				  {0xE8, "Linux LUKS"},
 				  {0xEB, "BeOS fs"},
 				  {0xF1, "SpeedStor"},
 				  {0xF2, "DOS 3.3+ Secondary"},
@@ -630,15 +699,14 @@ static void print_mboot_block(disk_desc *d)
 	}
 }
 
-static void read_part_table(disk_desc *d, s64_t sec, byte_t *where)
+/*
+ * read the ptbl sector sec via the aligned buffer buf.
+ */
+
+static void read_part_sector(disk_desc *d, s64_t sec, byte_t *buf, byte_t *where)
 {
 	ssize_t rd;
-	size_t psize;
-	byte_t *ubuf, *buf;
 
-	psize = getpagesize();
-	ubuf = alloc(MAXSSIZE + psize);
-	buf = align(ubuf, psize);
 	sec *= d->d_ssize;
 	if (l64seek(d->d_fd, sec, SEEK_SET) == -1)
 		pr(FATAL, EM_SEEKFAILURE, d->d_dev);
@@ -651,16 +719,69 @@ static void read_part_table(disk_desc *d, s64_t sec, byte_t *where)
 	if (rd == -1)
 		pr(FATAL, EM_PTBLREAD);
 	memcpy(where, buf, 512);
-	free((void *)ubuf);
 }
 
+static void read_part_table(disk_desc *d, s64_t sec, byte_t *where)
+{
+	byte_t *buf;
+
+	buf = gm_getbuf(d, MAXSSIZE);
+	read_part_sector(d, sec, buf, where);
+	gm_putbuf(d, buf);
+}
+
+/*
+ * a set of sectors, open addressing. Slots hold sector + 1,
+ * 0 is an empty slot.
+ */
+
+typedef struct
+{
+	s64_t		*v_sec;
+	size_t		v_n, v_max;	/* v_max is a power of 2 */
+} sec_set;
+
+static int sec_set_add(sec_set *vs, s64_t sec)
+{
+	sec_set nvs;
+	size_t i;
+
+	if (2 * (vs->v_n + 1) > vs->v_max) {
+		nvs.v_max = vs->v_max ? 2 * vs->v_max : 256;
+		nvs.v_n = 0;
+		nvs.v_sec = (s64_t *)alloc(nvs.v_max * sizeof(s64_t));
+		for (i = 0; i < vs->v_max; i++)
+			if (vs->v_sec[i])
+				sec_set_add(&nvs, vs->v_sec[i] - 1);
+		if (vs->v_sec)
+			free((void *)vs->v_sec);
+		*vs = nvs;
+	}
+	for (i = (((uint64_t)sec * 0x9e3779b97f4a7c15ULL) >> 32) & (vs->v_max - 1); vs->v_sec[i];
+		 i = (i + 1) & (vs->v_max - 1))
+		if (vs->v_sec[i] == sec + 1)
+			return (0);
+	vs->v_sec[i] = sec + 1;
+	vs->v_n++;
+	return (1);
+}
+
+/*
+ * walk the chain of extended ptbls. All links are read into
+ * the same buffer and a chain looping back to a link already
+ * read is cut there.
+ */
+
 static void read_ext_part_table(disk_desc *d, dos_part_table *pt)
 {
 	dos_part_entry *p, *ep;
 	s64_t epsize, epstart, epoffset;
-	int epcount;
+	byte_t *buf;
+	sec_set vs;
 
-	epsize = epstart = epoffset = epcount = 0;
+	buf = gm_getbuf(d, MAXSSIZE);
+	memset(&vs, 0, sizeof(vs));
+	epsize = epstart = epoffset = 0;
 	while (1) {
 		ep = 0;
 		for (p = pt->t_parts; p <= &pt->t_parts[NDOSPARTS - 1]; p++)
@@ -673,12 +794,7 @@ static void read_ext_part_table(disk_desc *d, dos_part_table *pt)
 			}
 
 		if (ep == 0)
-			return;
-		if (++epcount > 128) /* arbitrary maximum */
-		{
-			pr(ERROR, EM_TOOMANYLOGP, 128);
-			return;
-		}
+			break;
 		if (epstart == 0) {
 			epstart = ep->p_start;
 			epsize = ep->p_size;
@@ -687,57 +803,84 @@ static void read_ext_part_table(disk_desc *d, dos_part_table *pt)
 			epoffset = ep->p_start;
 		if (epoffset > epsize) {
 			pr(ERROR, EM_EPILLEGALOFS);
-			return;
+			break;
+		}
+		if (!sec_set_add(&vs, epstart + epoffset)) {
+			pr(ERROR, EM_EPLOOP, epstart + epoffset);
+			break;
 		}
 
 		/*
 		 * link in new extended ptbl.
 		 */
 
-		pt->t_ext = (dos_part_table *)alloc(sizeof(dos_part_table));
-		read_part_table(d, epstart + epoffset, (pt = pt->t_ext)->t_boot);
+		pt->t_ext = (dos_part_table *)gm_arena(d, sizeof(dos_part_table));
+		read_part_sector(d, epstart + epoffset, buf, (pt = pt->t_ext)->t_boot);
 		if (!is_ext_parttable(d, pt->t_boot)) {
 			pr(ERROR, EM_INVXPTBL, epstart + epoffset);
-			return;
+			break;
 		}
 	}
+	if (vs.v_sec)
+		free((void *)vs.v_sec);
+	gm_putbuf(d, buf);
 }
 
 static void free_disk_desc(disk_desc *d)
 {
-	dos_part_table *pt;
-	dos_guessed_pt *pg;
-	void *t;
+	gm_freearena(d);
+	gm_freebufs(d);
+	free((void *)d);
+}
 
-	for (pt = d->d_pt.t_ext; pt;) {
-		t = pt->t_ext;
-		free((void *)pt);
-		pt = t;
-	}
-	for (pt = d->d_gpt.t_ext; pt;) {
-		t = pt->t_ext;
-		free((void *)pt);
-		pt = t;
+/*
+ * use the geometry found (0 if not asked for) with
+ * the command line overrides.
+ */
+
+static void set_geometry(disk_desc *d, struct disk_geom *dg)
+{
+	if (f_getgeom) {
+		memcpy(&d->d_dg, dg, sizeof(struct disk_geom));
+		d->d_nsecs = dg->d_nsecs;
+
+		/*
+		 * command line geometry overrides
+		 */
+
+		if (gc)
+			d->d_dg.d_c = gc;
+		if (gh)
+			d->d_dg.d_h = gh;
+		if (gs)
+			d->d_dg.d_s = gs;
+	} else {
+		d->d_dg.d_c = gc;
+		d->d_dg.d_h = gh;
+		d->d_dg.d_s = gs;
 	}
-	for (pg = d->d_gl; pg;) {
-		t = pg->g_next;
-		free((void *)pg);
-		pg = t;
+	if (d->d_dg.d_c < 1024)
+		d->d_dosc = 1;
+	if ((d->d_dg.d_h > 16) || (d->d_dg.d_s > 63))
+		d->d_lba = 1;
+
+	if (gh && gc && gs) {
+		/* Override number of sectors with command line parameters */
+		d->d_nsecs = d->d_dg.d_c;
+		d->d_nsecs *= d->d_dg.d_h;
+		d->d_nsecs *= d->d_dg.d_s;
 	}
-	free((void *)d);
 }
 
 static disk_desc *get_disk_desc(char *dev, int sectsize)
 {
-	byte_t *ubuf, *buf;
+	byte_t *buf;
 	disk_desc *d;
-	int psize, ssize;
+	int ssize;
 	struct disk_geom *dg;
 
-	psize = getpagesize();
-	ubuf = alloc(MAXSSIZE + psize);
-	buf = align(ubuf, psize);
 	d = (disk_desc *)alloc(sizeof(disk_desc));
+	buf = gm_getbuf(d, MAXSSIZE);
 
 	/*
 	 * I don't care if the given name denotes a block or character
@@ -773,106 +916,1605 @@ static disk_desc *get_disk_desc(char *dev, int sectsize)
 
 	d->d_dev = dev;
 	read_part_table(d, 0, d->d_pt.t_boot);
-	if (f_getgeom) {
-		if ((dg = disk_geometry(d)) == 0)
-			pr(FATAL, EM_CANTGETGEOM);
-		memcpy(&d->d_dg, dg, sizeof(struct disk_geom));
+	dg = 0;
+	if (f_getgeom && ((dg = disk_geometry(d)) == 0))
+		pr(FATAL, EM_CANTGETGEOM);
+	set_geometry(d, dg);
+	read_ext_part_table(d, &d->d_pt);
+	close(d->d_fd);
+	gm_putbuf(d, buf);
+	return (d);
+}
 
-		d->d_nsecs = dg->d_nsecs;
+/*
+ * a replay takes the device description from the trace.
+ */
+
+static disk_desc *replay_disk_desc(char **files, int nfiles)
+{
+	struct disk_geom dg;
+	disk_desc *d;
+	int i;
+
+	d = (disk_desc *)alloc(sizeof(disk_desc));
+	for (i = 0; i < nfiles; i++)
+		trc_load(d, files[i], &dg);
+	set_geometry(d, &dg);
+	return (d);
+}
+
+static dos_guessed_pt *new_guessed_p(disk_desc *d, dos_part_entry *p, int cnt)
+{
+	dos_guessed_pt *gpt;
+
+	gpt = (dos_guessed_pt *)gm_arena(d, sizeof(dos_guessed_pt));
+	gpt->g_ext = (cnt > 1);
+	for (; cnt > 0; cnt--)
+		memcpy(&gpt->g_p[cnt - 1], &p[cnt - 1], sizeof(dos_part_entry));
+	gpt->g_sec = d->d_nsb;
+	return (gpt);
+}
+
+/*
+ * add a guess, keeping the list sorted by the sector it
+ * was found at. Guesses may be found out of scan order,
+ * mostly they are appended though.
+ */
+
+static dos_guessed_pt *insert_guessed_p(disk_desc *d, dos_part_entry *p, int cnt)
+{
+	dos_guessed_pt *gpt, **gpp;
+
+	if (d->d_gltail && (d->d_gltail->g_sec <= d->d_nsb))
+		gpp = &d->d_gltail->g_next;
+	else
+		for (gpp = &d->d_gl; *gpp; gpp = &(*gpp)->g_next)
+			if ((*gpp)->g_sec > d->d_nsb)
+				break;
+	gpt = new_guessed_p(d, p, cnt);
+	if ((gpt->g_next = *gpp) == 0)
+		d->d_gltail = gpt;
+	*gpp = gpt;
+	return (gpt);
+}
+
+/*
+ * add the partition guessed by module m.
+ */
+
+static dos_guessed_pt *insert_mod_guess(disk_desc *d, g_module *m)
+{
+	dos_guessed_pt *gp;
+
+	gp = insert_guessed_p(d, &m->m_part, 1);
+	gp->g_mod = m;
+	gp->g_weight = m->m_guess * m->m_weight;
+	gp->g_size = m->m_size;
+	return (gp);
+}
+
+static s64_t gp_size(dos_guessed_pt *gp) { return (gp->g_size ? gp->g_size : gp->g_p[0].p_size); }
+
+static g_module *get_best_guess(g_module **g, int count)
+{
+	int mx, i;
+	float bestg = 0.0;
+
+	/*
+	 * up to now the best guess is simple that one which
+	 * reported the largest probability (if there are more
+	 * than one, the first of them in the module order).
+	 * The modules may have been evaluated in another order.
+	 */
+
+	for (mx = i = 0; i < count; i++)
+		if ((g[i]->m_guess * g[i]->m_weight > bestg) ||
+			((g[i]->m_guess * g[i]->m_weight == bestg) && (bestg > 0.0) && (g[i]->m_order < g[mx]->m_order)))
+			bestg = g[mx = i]->m_guess * g[i]->m_weight;
+
+	return ((bestg > 0.0) ? g[mx] : 0);
+}
+
+static int mod_is_aligned(disk_desc *d, g_module *m)
+{
+	s64_t al;
+
+	switch (m->m_align) {
+	case 'h':
+		return (on_head_boundary(d, d->d_nsb));
+
+	case 'c':
+		return (on_cyl_boundary(d, d->d_nsb));
+
+	case 1:
+	case 's':
+		return (1);
+	default:
+		if (m->m_align > 0) {
+			al = d->d_nsb;
+			al %= m->m_align;
+			return (al == 0);
+		}
+		break;
+	}
+	return (1);
+}
+
+/*
+ * convert an increment given on the command line
+ * into a number of sectors.
+ */
+
+static unsigned long incr_sectors(disk_desc *d, unsigned long incr)
+{
+	switch (incr) {
+	case 's':
+	case 'a':
+		incr = 1;
+		break;
+	case 'h':
+		incr = d->d_dg.d_s;
+		break;
+	case 'c':
+		incr = d->d_dg.d_s * d->d_dg.d_h;
+		break;
+	}
+	return (incr ? incr : 1);
+}
+
+/*
+ * read the window of sectors starting at sec into the
+ * sector buffer. Afterwards the file position is at the
+ * end of the window.
+ */
+
+static ssize_t read_window(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	if (trc_mode == TRC_REPLAY)
+		return (trc_read(d, sc->s_bsize, sc->s_nsecs, sec));
+	if (l64seek(d->d_fd, sec * d->d_ssize, SEEK_SET) == -1)
+		pr(FATAL, EM_SEEKFAILURE, d->d_dev);
+	return (bread(d->d_fd, d->d_sbuf, d->d_ssize, sc->s_nsecs));
+}
+
+/*
+ * let module m check the window within the read budget, a
+ * check exceeding it is rejected. End probes pass the end.
+ */
+
+static int gm_check(disk_desc *d, g_module *m, s64_t end)
+{
+	int ret;
+
+	gm_budget(d, rbkb * 1024, rbms);
+	ret = end ? (*m->m_efun)(d, m, end) : (*m->m_gfun)(d, m);
+	if (d->d_rbover) {
+		m->m_guess = GM_NO;
+		m->m_overbudget++;
+	}
+	gm_budget(d, 0, 0);
+	return (ret);
+}
+
+/*
+ * module order: the modules are evaluated cheapest per hit
+ * first, measured on every RO_SAMPLE-th window of the scan.
+ * Once none of the modules still to come can beat the best
+ * guess, the others are left out.
+ */
+
+static s64_t now_ns()
+{
+	struct timespec ts;
 
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((s64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static double mod_cost(g_module *m) { return ((double)m->m_ns / (m->m_timed + 1) * (m->m_calls + 2) / (m->m_hits + 1)); }
+
+static int cmp_modcost(g_module *a, g_module *b)
+{
+	double x = mod_cost(a), y = mod_cost(b);
+
+	return ((x > y) - (x < y));
+}
+
+static int cmp_modorder(g_module *a, g_module *b) { return (a->m_order - b->m_order); }
+
+static int mod_decided(g_module *bg, g_module *m)
+{
+	float bestg = bg->m_guess * bg->m_weight, g;
+
+	for (; m; m = m->m_next) {
+		g = m->m_maxguess * m->m_weight;
+		if ((g > bestg) || ((g == bestg) && (m->m_order < bg->m_order)))
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * ask all modules about the window in the sector buffer,
+ * collect those which think they have found something.
+ */
+
+static int eval_modules(disk_desc *d, scan_desc *sc)
+{
+	g_module *m;
+	s64_t fpos, t;
+	int mod = 0, skip, found, decided = 0, timed;
+
+	fpos = d->d_nsb * d->d_ssize + sc->s_bsize;
+	bpb_decode(d->d_sbuf, &d->d_bpb);
+	if (((++sc->s_nevals % RO_INTERVAL) == 0) && sc->s_reorder)
+		g_mod_sort(cmp_modcost);
+	timed = (sc->s_nevals % RO_SAMPLE) == 0;
+	for (m = g_mod_head(); m; m = m->m_next) {
 		/*
-		 * command line geometry overrides
+		 * an index or a trace being recorded needs the hits
+		 * of all modules, whatever the current options are.
 		 */
 
-		if (gc)
-			d->d_dg.d_c = gc;
-		if (gh)
-			d->d_dg.d_h = gh;
-		if (gs)
-			d->d_dg.d_s = gs;
-	} else {
-		d->d_dg.d_c = gc;
-		d->d_dg.d_h = gh;
-		d->d_dg.d_s = gs;
+		skip = m->m_skip || (sc->s_in_ext && m->m_notinext) || !mod_is_aligned(d, m);
+		if (skip && (idx_mode != IDX_RECORD) && (trc_mode != TRC_RECORD))
+			continue;
+		if (decided) {
+			m->m_saved++;
+			continue;
+		}
+
+		/*
+		 * because a gmodule is allowed to seek on
+		 * d->d_fd the current file position must be
+		 * restored after calling it.
+		 */
+
+		memset(&m->m_part, 0, sizeof(dos_part_entry));
+		m->m_size = 0;
+		m->m_cflen = 0;
+		m->m_guess = GM_NO;
+		if ((trc_mode != TRC_REPLAY) || ((found = trc_eval(d, m)) < 0)) {
+			if (timed) {
+				t = now_ns();
+				found = gm_check(d, m, 0);
+				m->m_ns += now_ns() - t;
+				m->m_timed++;
+			} else
+				found = gm_check(d, m, 0);
+			m->m_calls++;
+			l64seek(d->d_fd, fpos, SEEK_SET);
+		}
+		if (found) {
+			idx_hit_mod(d, m);
+			trc_hit_mod(d, m);
+			if (!skip && (m->m_guess * m->m_weight >= GM_PERHAPS)) {
+				sc->s_guesses[mod++] = m;
+				m->m_hits++;
+				decided = sc->s_reorder && mod_decided(get_best_guess(sc->s_guesses, mod), m->m_next);
+			}
+		}
 	}
-	if (d->d_dg.d_c < 1024)
-		d->d_dosc = 1;
-	if ((d->d_dg.d_h > 16) || (d->d_dg.d_s > 63))
-		d->d_lba = 1;
+	return (mod);
+}
 
-	if (gh && gc && gs) {
-		/* Override number of sectors with command line parameters */
-		d->d_nsecs = d->d_dg.d_c;
-		d->d_nsecs *= d->d_dg.d_h;
-		d->d_nsecs *= d->d_dg.d_s;
+static void add_range(range_list *rl, s64_t from, s64_t to, s64_t by)
+{
+	s_range *r;
+
+	if (from >= to)
+		return;
+	if (rl->rl_n == rl->rl_max) {
+		rl->rl_max = rl->rl_max ? 2 * rl->rl_max : 16;
+		if ((rl->rl_r = (s_range *)realloc(rl->rl_r, rl->rl_max * sizeof(s_range))) == 0)
+			pr(FATAL, EM_MALLOCFAILED, rl->rl_max * sizeof(s_range));
 	}
+	r = &rl->rl_r[rl->rl_n++];
+	r->r_start = from;
+	r->r_end = to;
+	r->r_sec = by;
+}
 
-	read_ext_part_table(d, &d->d_pt);
-	close(d->d_fd);
-	free((void *)ubuf);
-	return (d);
+static void free_ranges(range_list *rl)
+{
+	if (rl->rl_r)
+		free((void *)rl->rl_r);
+	memset(rl, 0, sizeof(range_list));
+}
+
+/*
+ * deferred confirmations (--defer). A guess whose module left
+ * its confirmation to the scan is kept as provisional, and the
+ * fast scan jumps over it as usual. The confirmations are made
+ * from the scan window when the scan passes over their data,
+ * the remaining ones in batches in ascending offset order from
+ * the current position on. A rejected guess is removed, its
+ * sector and the range jumped over are scanned again later.
+ */
+
+static void del_range(range_list *rl, s64_t by)
+{
+	int i;
+
+	for (i = 0; i < rl->rl_n; i++)
+		if (rl->rl_r[i].r_sec == by) {
+			memmove(&rl->rl_r[i], &rl->rl_r[i + 1], (rl->rl_n - i - 1) * sizeof(s_range));
+			rl->rl_n--;
+			return;
+		}
+}
+
+static void cf_reject(disk_desc *d, scan_desc *sc, cf_item *c)
+{
+	dos_guessed_pt *gp = c->c_gp, *pp = 0, **gpp;
+	s64_t size = gp_size(gp), ofs = gp->g_sec;
+
+	s2mb(d, ofs);
+	pr(MSG, PM_CFREJECTED, c->c_mod->m_desc ? c->c_mod->m_desc : c->c_mod->m_name, ofs);
+	if (f_fast) {
+		if (size % sc->s_incr)
+			size += sc->s_incr - size % sc->s_incr;
+		del_range(&sc->s_bf, gp->g_sec);
+	} else
+		size = sc->s_incr;
+	add_range(&sc->s_rb, gp->g_sec, gp->g_sec + size, gp->g_sec);
+	for (gpp = &d->d_gl; *gpp; pp = *gpp, gpp = &(*gpp)->g_next)
+		if (*gpp == gp) {
+			if ((*gpp = gp->g_next) == 0)
+				d->d_gltail = pp;
+			break;
+		}
+	sc->s_dlnext = 0;
+	sc->s_dlend = 0;
+	sc->s_cfrej++;
+}
+
+static void cf_confirm(disk_desc *d, scan_desc *sc, cf_item *c, byte_t *buf)
+{
+	if (buf && (*c->c_mod->m_cfun)(d, c->c_mod, buf, c->c_key))
+		c->c_gp->g_prov = 0;
+	else
+		cf_reject(d, sc, c);
+}
+
+static int cmp_cf(const void *a, const void *b)
+{
+	s64_t x = ((cf_item *)a)->c_ofs, y = ((cf_item *)b)->c_ofs;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * serve all pending confirmations, from head (in sectors) on
+ * up and then from the lowest offset.
+ */
+
+static void cf_serve(disk_desc *d, scan_desc *sc, s64_t head)
+{
+	cf_item *c;
+	byte_t *buf;
+	int i, k;
+
+	if (sc->s_ncf == 0)
+		return;
+	qsort(sc->s_cf, sc->s_ncf, sizeof(cf_item), cmp_cf);
+	for (k = 0; (k < sc->s_ncf) && (sc->s_cf[k].c_ofs < head * d->d_ssize); k++)
+		;
+	for (i = 0; i < sc->s_ncf; i++) {
+		c = &sc->s_cf[(k + i) % sc->s_ncf];
+		buf = gm_getbuf(d, c->c_len);
+		cf_confirm(d, sc, c, (gm_read(d, c->c_ofs, buf, c->c_len) == c->c_len) ? buf : 0);
+		gm_putbuf(d, buf);
+		sc->s_cfread++;
+	}
+	sc->s_ncf = 0;
+}
+
+/*
+ * the window at sec has just been read, serve the confirmations
+ * it holds the data for.
+ */
+
+static void cf_window(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	s64_t ofs = sec * d->d_ssize;
+	cf_item *c;
+	int i;
+
+	for (i = 0; i < sc->s_ncf;) {
+		c = &sc->s_cf[i];
+		if ((c->c_ofs < ofs) || (c->c_ofs + c->c_len > ofs + sc->s_bsize)) {
+			i++;
+			continue;
+		}
+		cf_confirm(d, sc, c, d->d_sbuf + (c->c_ofs - ofs));
+		sc->s_cfwin++;
+		*c = sc->s_cf[--sc->s_ncf];
+	}
+}
+
+static void cf_add(disk_desc *d, scan_desc *sc, g_module *m, dos_guessed_pt *gp)
+{
+	cf_item *c;
+
+	if (sc->s_ncf == CF_BATCH)
+		cf_serve(d, sc, d->d_nsb);
+	c = &sc->s_cf[sc->s_ncf++];
+	c->c_ofs = m->m_cfofs;
+	c->c_len = m->m_cflen;
+	c->c_mod = m;
+	c->c_gp = gp;
+	memcpy(c->c_key, m->m_cfkey, GM_CFKEYLEN);
+	gp->g_prov = 1;
+}
+
+/*
+ * investigate the window at d->d_nsb: modules and extended
+ * ptbls. Returns the number of sectors the found partition
+ * occupies, 0 if nothing was found.
+ */
+
+static s64_t guess_sector(disk_desc *d, scan_desc *sc)
+{
+	g_module *m, *bg;
+	dos_guessed_pt *gp;
+	int mod, have_ext = 0;
+	s64_t sz, ofs, noffset;
+
+	ofs = d->d_nsb;
+	s2mb(d, ofs);
+
+	/*
+	 * reset modules
+	 */
+
+	for (m = g_mod_head(); m; m = m->m_next)
+		m->m_skip = 0;
+	trc_sector(d);
+
+guessit:
+	bg = 0;
+	noffset = 0;
+	mod = eval_modules(d, sc);
+
+	/*
+	 * now fetch the best guess.
+	 */
+
+	if (mod && (bg = get_best_guess(sc->s_guesses, mod))) {
+		noffset = g_mod_size(bg);
+		fillin_dos_chs(d, &bg->m_part, 0);
+	}
+
+	/*
+	 * extended partition begin?
+	 */
+
+	if (f_testext && boundary_fun(d, d->d_nsb) && (!bg || !bg->m_hasptbl) && is_ext_parttable(d, d->d_sbuf)) {
+		dos_part_entry *p;
+		int no_ext;
+
+		p = (dos_part_entry *)(d->d_sbuf + DOSPARTOFF);
+		no_ext = no_of_ext_partitions(p);
+		if (!sc->s_in_ext) {
+			pr(MSG, PM_POSSIBLEEXTPART, ofs);
+			sc->s_in_ext = 1;
+			sc->s_end_of_ext = 0;
+			noffset = 0;
+		} else if (no_ext == 0)
+			sc->s_end_of_ext = 1;
+
+		if (sc->s_in_ext) {
+			if (f_interactive) {
+				if (yesno(DM_ACCEPTGUESS))
+					insert_guessed_p(d, p, have_ext = NDOSPARTS);
+				else if (mod && bg) {
+					bg->m_skip = 1;
+					goto guessit;
+				}
+			} else
+				insert_guessed_p(d, p, have_ext = NDOSPARTS);
+		}
+	}
+
+	if (!have_ext && noffset) {
+		sz = noffset;
+		s2mb(d, sz);
+		if (sc->s_in_ext)
+			pr(MSG, "   ");
+		pr(MSG, PM_POSSIBLEPART, bg->m_desc ? bg->m_desc : bg->m_name, sz, ofs);
+		if (f_verbose)
+			print_partition(d, &bg->m_part, sc->s_in_ext ? 1 : 0, 0);
+		if (f_interactive)
+			if (!yesno(DM_ACCEPTGUESS)) {
+				noffset = 0;
+				if (mod && bg) {
+					bg->m_skip = 1;
+					goto guessit;
+				}
+			}
+
+		if (noffset) {
+			gp = insert_mod_guess(d, bg);
+			if (bg->m_cflen)
+				cf_add(d, sc, bg, gp);
+			if (sc->s_end_of_ext)
+				sc->s_in_ext = 0;
+		}
+	}
+	return (noffset);
+}
+
+/*
+ * the backfill pass: look into the ranges the fast scan
+ * jumped over. A wrong partition size (e.g. from an old
+ * superblock) may have hidden real partitions there, every
+ * guess found is marked and raised when checking the list.
+ */
+
+static void do_backfill(disk_desc *d, scan_desc *sc)
+{
+	g_module *m, *bg;
+	s_range *r;
+	s64_t sec, bfincr, sz, ofs;
+	int mod;
+
+	if (sc->s_bf.rl_n == 0)
+		return;
+	bfincr = bfincrement ? incr_sectors(d, bfincrement) : BF_DEFINCR / d->d_ssize;
+	if (bfincr == 0)
+		bfincr = 1;
+
+	pr(MSG, DM_STARTBACKFILL, sc->s_bf.rl_n);
+	sc->s_in_ext = 0;
+	for (r = sc->s_bf.rl_r; r < &sc->s_bf.rl_r[sc->s_bf.rl_n]; r++) {
+		sec = r->r_start + bfincr - 1;
+		sec -= sec % bfincr;
+		for (; sec < r->r_end; sec += bfincr) {
+			if (maxsec && (sec > maxsec))
+				break;
+			if (read_window(d, sc, sec) != sc->s_bsize)
+				continue;
+			d->d_nsb = sec;
+			for (m = g_mod_head(); m; m = m->m_next)
+				m->m_skip = 0;
+			trc_sector(d);
+			if (((mod = eval_modules(d, sc)) == 0) || ((bg = get_best_guess(sc->s_guesses, mod)) == 0))
+				continue;
+			if (bg->m_part.p_size == 0)
+				continue;
+
+			fillin_dos_chs(d, &bg->m_part, 0);
+			sz = g_mod_size(bg);
+			s2mb(d, sz);
+			ofs = sec;
+			s2mb(d, ofs);
+			pr(MSG, PM_POSSIBLEPART, bg->m_desc ? bg->m_desc : bg->m_name, sz, ofs);
+			if (f_verbose)
+				print_partition(d, &bg->m_part, 0, 0);
+			insert_mod_guess(d, bg)->g_bf = 1;
+		}
+	}
+}
+
+/*
+ * end probes: backup structures at the end of a volume tell its
+ * start and size from a single window. Probed are the windows
+ * ending at the end of the disk and at the start and the end of
+ * each guess, in reverse order. The start of a volume found this way is
+ * probed again, so neighbouring volumes are found backwards.
+ */
+
+typedef struct
+{
+	s64_t		*e_sec;		/* ends to probe, descending */
+	int		e_n, e_max, e_next;
+} ep_list;
+
+static void ep_add(disk_desc *d, ep_list *el, s64_t end)
+{
+	s64_t a = DL_ALIGN / d->d_ssize, e;
+	int i, j;
+
+	for (j = 0; j < 2; j++) {
+		e = j ? end - end % a : end;
+		for (i = el->e_next; (i < el->e_n) && (el->e_sec[i] > e); i++)
+			;
+		if ((e <= 0) || (el->e_next && (e >= el->e_sec[el->e_next - 1])) || ((i < el->e_n) && (el->e_sec[i] == e)))
+			continue;
+		if (el->e_n == el->e_max) {
+			el->e_max = el->e_max ? 2 * el->e_max : 64;
+			if ((el->e_sec = (s64_t *)realloc(el->e_sec, el->e_max * sizeof(s64_t))) == 0)
+				pr(FATAL, EM_MALLOCFAILED, el->e_max * sizeof(s64_t));
+		}
+		memmove(&el->e_sec[i + 1], &el->e_sec[i], (el->e_n - i) * sizeof(s64_t));
+		el->e_sec[i] = e;
+		el->e_n++;
+	}
+}
+
+static int ep_known(disk_desc *d, s64_t sec)
+{
+	dos_guessed_pt *gp;
+
+	for (gp = d->d_gl; gp && (gp->g_sec <= sec); gp = gp->g_next)
+		if (gp->g_sec == sec)
+			return (1);
+	return (0);
+}
+
+static void ep_probe(disk_desc *d, scan_desc *sc, ep_list *el, s64_t end)
+{
+	gpt_header *h;
+	g_module *m, *bg;
+	s64_t sec = end - sc->s_nsecs, sz, ofs;
+	int mod = 0;
+
+	if ((sec < 0) || (read_window(d, sc, sec) != sc->s_bsize))
+		return;
+	d->d_nsb = sec;
+	if (end == d->d_nsecs) {
+		h = (gpt_header *)(d->d_sbuf + (sc->s_nsecs - 1) * d->d_ssize);
+		if (gpt_is_header(d, (byte_t *)h, end - 1)) {
+			pr(MSG, PM_GPTBACKUP, end - 1, le64(h->h_first), le64(h->h_last), le32(h->h_nents),
+				le64(h->h_entlba));
+			ep_add(d, el, le64(h->h_last) + 1);
+		}
+	}
+
+	for (m = g_mod_head(); m; m = m->m_next) {
+		if (m->m_efun == 0)
+			continue;
+		memset(&m->m_part, 0, sizeof(dos_part_entry));
+		m->m_size = 0;
+		m->m_guess = GM_NO;
+		if (gm_check(d, m, end) && m->m_part.p_size && (m->m_guess * m->m_weight >= GM_PERHAPS))
+			sc->s_guesses[mod++] = m;
+	}
+	if ((mod == 0) || ((bg = get_best_guess(sc->s_guesses, mod)) == 0))
+		return;
+	if ((bg->m_part.p_start < skipsec) || ep_known(d, bg->m_part.p_start))
+		return;
+
+	d->d_nsb = bg->m_part.p_start;
+	fillin_dos_chs(d, &bg->m_part, 0);
+	sz = g_mod_size(bg);
+	s2mb(d, sz);
+	ofs = d->d_nsb;
+	s2mb(d, ofs);
+	pr(MSG, PM_ENDPROBEPART, bg->m_desc ? bg->m_desc : bg->m_name, sz, ofs);
+	if (f_verbose)
+		print_partition(d, &bg->m_part, 0, 0);
+	insert_mod_guess(d, bg);
+	ep_add(d, el, d->d_nsb);
+}
+
+static void do_endprobes(disk_desc *d, scan_desc *sc)
+{
+	dos_guessed_pt *gp;
+	ep_list el;
+
+	memset(&el, 0, sizeof(el));
+	if (d->d_nsecs && !maxsec)
+		ep_add(d, &el, d->d_nsecs);
+	for (gp = d->d_gl; gp; gp = gp->g_next) {
+		ep_add(d, &el, gp->g_sec);
+		if (!gp->g_ext)
+			ep_add(d, &el, gp->g_sec + gp_size(gp));
+	}
+	sc->s_in_ext = 0;
+	while (el.e_next < el.e_n)
+		ep_probe(d, sc, &el, el.e_sec[el.e_next++]);
+	if (el.e_sec)
+		free((void *)el.e_sec);
+}
+
+static int cmp_range(const void *a, const void *b)
+{
+	s64_t x = ((s_range *)a)->r_start, y = ((s_range *)b)->r_start;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * a valid GPT describes partitions which need not be scanned.
+ * Each entry is confirmed by the modules at its first lba,
+ * the scan passes over the confirmed ones.
+ */
+
+static void do_gpt(disk_desc *d, scan_desc *sc)
+{
+	gpt_header h;
+	gpt_entry *e;
+	byte_t *ents;
+	s64_t first, last, sz;
+	int i, backup, in_ext = sc->s_in_ext, end_of_ext = sc->s_end_of_ext;
+
+	if ((ents = gpt_read(d, &h, &backup)) == 0)
+		return;
+	pr(MSG, PM_GPTFOUND, backup ? "backup" : "primary", le32(h.h_nents));
+	for (i = 0; i < le32(h.h_nents); i++) {
+		e = (gpt_entry *)(ents + i * le32(h.h_entsize));
+		if (gpt_is_unused(e))
+			continue;
+		first = le64(e->e_first);
+		last = le64(e->e_last);
+		if ((first > last) || (first < le64(h.h_first)) || (last > le64(h.h_last)))
+			continue;
+
+		/*
+		 * a resumed scan knows the partition already.
+		 */
+
+		if (ep_known(d, first)) {
+			add_range(&sc->s_gpt, first, last + 1, first);
+			continue;
+		}
+		sz = 0;
+		if (read_window(d, sc, first) == sc->s_bsize) {
+			d->d_nsb = first;
+			sc->s_in_ext = sc->s_end_of_ext = 0;
+			sz = guess_sector(d, sc);
+		}
+		if (sz > 0)
+			add_range(&sc->s_gpt, first, max(last + 1, first + sz), first);
+		else
+			pr(MSG, PM_GPTNOTCONF, i + 1, first, last);
+	}
+	sc->s_in_ext = in_ext;
+	sc->s_end_of_ext = end_of_ext;
+	qsort(sc->s_gpt.rl_r, sc->s_gpt.rl_n, sizeof(s_range), cmp_range);
+	free((void *)ents);
+}
+
+/*
+ * next scan position not within a confirmed GPT partition.
+ */
+
+static s64_t gpt_skip(scan_desc *sc, s64_t sec)
+{
+	s_range *r;
+
+	for (r = sc->s_gpt.rl_r; r < &sc->s_gpt.rl_r[sc->s_gpt.rl_n]; r++)
+		if ((sec >= r->r_start) && (sec < r->r_end))
+			sec += (r->r_end - sec + sc->s_incr - 1) / sc->s_incr * sc->s_incr;
+	return (sec);
+}
+
+/*
+ * checkpoints. A checkpoint holds everything needed to continue
+ * an interrupted scan: the options it was started with, the next
+ * sector to scan, the extended ptbl state, the guesses and the
+ * skipped and unreadable ranges. It is a small text file which
+ * is written to a temporary file first and then renamed.
+ */
+
+#define CK_MAGIC	"gpart-checkpoint"
+#define CK_VERSION	4
+#define CK_HDRSIZE	4096
+
+static void ck_header(disk_desc *d, char *buf, size_t len)
+{
+	g_module *m;
+	size_t n;
+	int i;
+
+	n = snprintf(buf, len, "dev %lld %d %ld %ld %ld\n", (long long)d->d_nsecs, (int)d->d_ssize, d->d_dg.d_c,
+				 d->d_dg.d_h, d->d_dg.d_s);
+	n += snprintf(buf + n, len - n, "opts %lu %lu %d %d %d %d %d %lld %lld %d %lu %d %d %ld %ld\n", increment,
+				  bfincrement, f_fast, f_testext, f_backfill, f_skiperrors, f_gpt, (long long)skipsec,
+				  (long long)maxsec, f_entskip, entincrement, f_endprobe, f_defer, rbkb, rbms);
+
+	/*
+	 * in the order the scan started with, the list may have
+	 * been reordered since.
+	 */
+
+	for (i = 0; i < g_mod_count(); i++)
+		for (m = g_mod_head(); m && (n < len); m = m->m_next)
+			if (m->m_order == i)
+				n += snprintf(buf + n, len - n, "mod %s %g\n", m->m_name, m->m_weight);
+}
+
+static void write_ranges(FILE *fp, char *what, range_list *rl)
+{
+	s_range *r;
+
+	for (r = rl->rl_r; r < &rl->rl_r[rl->rl_n]; r++)
+		fprintf(fp, "%s %lld %lld %lld\n", what, (long long)r->r_start, (long long)r->r_end, (long long)r->r_sec);
+}
+
+static void write_checkpoint(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	char tmp[1024], hdr[CK_HDRSIZE];
+	dos_guessed_pt *gp;
+	FILE *fp;
+	int i, n;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", ckfile);
+	if ((fp = fopen(tmp, "w")) == 0) {
+		pr(ERROR, EM_CKWRITE, tmp, strerror(errno));
+		return;
+	}
+	ck_header(d, hdr, sizeof(hdr));
+	fprintf(fp, "%s %d\n%s", CK_MAGIC, CK_VERSION, hdr);
+	fprintf(fp, "pos %lld %d %d\n", (long long)sec, sc->s_in_ext, sc->s_end_of_ext);
+	for (gp = d->d_gl; gp; gp = gp->g_next) {
+		fprintf(fp, "guess %lld %d %s ", (long long)gp->g_sec, gp->g_ext, gp->g_mod ? gp->g_mod->m_name : "-");
+		n = (gp->g_ext ? NDOSPARTS : 1) * sizeof(dos_part_entry);
+		for (i = 0; i < n; i++)
+			fprintf(fp, "%02x", ((byte_t *)gp->g_p)[i]);
+		fprintf(fp, " %g %d %lld\n", gp->g_weight, gp->g_bf, (long long)gp->g_size);
+	}
+	write_ranges(fp, "skip", &sc->s_bf);
+	write_ranges(fp, "bad", &sc->s_bad);
+	if (sc->s_entstep) {
+		fprintf(fp, "ent %lld %lld %lld %lld\n", (long long)sc->s_ent_from, (long long)sc->s_ent_skip,
+			(long long)sc->s_ent_last, (long long)sc->s_ent_hold);
+		write_ranges(fp, "entropy", &sc->s_ent);
+	}
+	fprintf(fp, "end\n");
+	if (fflush(fp) || fsync(fileno(fp)) || ferror(fp)) {
+		pr(ERROR, EM_CKWRITE, tmp, strerror(errno));
+		fclose(fp);
+		return;
+	}
+	fclose(fp);
+	if (rename(tmp, ckfile) == -1)
+		pr(ERROR, EM_CKWRITE, ckfile, strerror(errno));
+}
+
+static void read_ck_guess(disk_desc *d, char *line)
+{
+	dos_part_entry p[NDOSPARTS];
+	dos_guessed_pt *gp;
+	char name[64], hex[2 * sizeof(p) + 1];
+	long long sec, size = 0;
+	unsigned int b;
+	float weight = GM_YES;
+	int ext, i, n, bf = 0;
+
+	if (sscanf(line, "guess %lld %d %63s %128s %f %d %lld", &sec, &ext, name, hex, &weight, &bf, &size) < 4)
+		pr(FATAL, EM_CKINVALID, ckfile);
+	n = (ext ? NDOSPARTS : 1) * sizeof(dos_part_entry);
+	if (strlen(hex) != 2 * n)
+		pr(FATAL, EM_CKINVALID, ckfile);
+	for (i = 0; i < n; i++) {
+		sscanf(hex + 2 * i, "%2x", &b);
+		((byte_t *)p)[i] = b;
+	}
+	d->d_nsb = sec;
+	gp = insert_guessed_p(d, p, ext ? NDOSPARTS : 1);
+	gp->g_mod = g_mod_lookup(GM_LOOKUP, name);
+	gp->g_weight = weight;
+	gp->g_bf = bf;
+	gp->g_size = size;
+}
+
+/*
+ * restore the scan state from the checkpoint, returns the
+ * sector to continue with.
+ */
+
+static s64_t read_checkpoint(disk_desc *d, scan_desc *sc)
+{
+	char line[512], hdr[CK_HDRSIZE], *h;
+	long long a, b, c, e;
+	s64_t sec = -1;
+	FILE *fp;
+	int v, done = 0;
+
+	if ((fp = fopen(ckfile, "r")) == 0)
+		pr(FATAL, EM_CKREAD, ckfile, strerror(errno));
+	if (!fgets(line, sizeof(line), fp) || (sscanf(line, CK_MAGIC " %d", &v) != 1) || (v != CK_VERSION))
+		pr(FATAL, EM_CKINVALID, ckfile);
+
+	/*
+	 * the scan must be continued exactly as it was started.
+	 */
+
+	ck_header(d, hdr, sizeof(hdr));
+	for (h = hdr; *h; h += strlen(line))
+		if (!fgets(line, sizeof(line), fp) || strncmp(line, h, strlen(line)))
+			pr(FATAL, EM_CKMISMATCH, ckfile);
+
+	while (!done && fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "pos ", 4) == 0) {
+			if (sscanf(line, "pos %lld %d %d", &a, &sc->s_in_ext, &sc->s_end_of_ext) != 3)
+				break;
+			sec = a;
+		} else if (strncmp(line, "guess ", 6) == 0)
+			read_ck_guess(d, line);
+		else if (sscanf(line, "skip %lld %lld %lld", &a, &b, &c) == 3)
+			add_range(&sc->s_bf, a, b, c);
+		else if (sscanf(line, "bad %lld %lld %lld", &a, &b, &c) == 3)
+			add_range(&sc->s_bad, a, b, c);
+		else if (sscanf(line, "ent %lld %lld %lld %lld", &a, &b, &c, &e) == 4) {
+			sc->s_ent_from = a;
+			sc->s_ent_skip = b;
+			sc->s_ent_last = c;
+			sc->s_ent_hold = e;
+		} else if (sscanf(line, "entropy %lld %lld %lld", &a, &b, &c) == 3)
+			add_range(&sc->s_ent, a, b, c);
+		else if (strcmp(line, "end\n") == 0)
+			done = 1;
+		else
+			break;
+	}
+	fclose(fp);
+	if (!done || (sec < 0))
+		pr(FATAL, EM_CKINVALID, ckfile);
+	return (sec);
+}
+
+/*
+ * continue a scan from the checkpoint. The guesses found
+ * before are reported again as the scan would have done.
+ */
+
+static s64_t resume_scan(disk_desc *d, scan_desc *sc)
+{
+	dos_guessed_pt *gp;
+	dos_part_entry *p;
+	g_module *m;
+	int in_ext = 0, end_of_ext = 0;
+	s64_t sec, sz, ofs;
+
+	sec = read_checkpoint(d, sc);
+	for (gp = d->d_gl; gp; gp = gp->g_next) {
+		ofs = gp->g_sec;
+		s2mb(d, ofs);
+		if (gp->g_ext) {
+			if (!in_ext) {
+				pr(MSG, PM_POSSIBLEEXTPART, ofs);
+				in_ext = 1;
+				end_of_ext = 0;
+			} else if (no_of_ext_partitions(gp->g_p) == 0)
+				end_of_ext = 1;
+			continue;
+		}
+		p = &gp->g_p[0];
+		m = gp->g_mod;
+		sz = p->p_size;
+		s2mb(d, sz);
+		if (in_ext)
+			pr(MSG, "   ");
+		pr(MSG, PM_POSSIBLEPART, m ? (m->m_desc ? m->m_desc : m->m_name) : "-", sz, ofs);
+		if (f_verbose)
+			print_partition(d, p, in_ext ? 1 : 0, 0);
+		if (end_of_ext)
+			in_ext = 0;
+	}
+	return (sec);
+}
+
+/*
+ * deadline mode: when time is short the most promising
+ * positions are investigated first. Aligned positions, the
+ * areas following found partitions, then cylinder and head
+ * boundaries and at last all the rest. Guesses found so far
+ * are checked and printed when time is up.
+ */
+
+static s64_t dl_probes = 0;
+
+/*
+ * returns the end of a found partition containing sec (jumped
+ * over when scanning fast) or sec + 1 if something was found
+ * at sec already, 0 otherwise.
+ */
+
+static s64_t dl_known(disk_desc *d, s64_t sec)
+{
+	dos_guessed_pt *gp;
+
+	for (gp = d->d_gl; gp && (gp->g_sec <= sec); gp = gp->g_next) {
+		if (gp->g_sec == sec)
+			return (sec + 1);
+		if (f_fast && !gp->g_ext && (sec < gp->g_sec + gp_size(gp)))
+			return (gp->g_sec + gp_size(gp));
+	}
+	return (0);
+}
+
+static int dl_timeout()
+{
+	if (!dl_expired && (time(0) >= dl_end))
+		dl_expired = 1;
+	return (dl_expired);
+}
+
+/*
+ * investigate the window at sec, returns 1 if something
+ * new was found.
+ */
+
+static int dl_visit(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	dos_guessed_pt *gp;
+
+	if (dl_timeout() || (sec < skipsec) || (maxsec && (sec > maxsec)) || dl_known(d, sec))
+		return (0);
+	if ((sec + sc->s_nsecs > d->d_nsecs) || (read_window(d, sc, sec) != sc->s_bsize))
+		return (0);
+	d->d_nsb = sec;
+	dl_probes++;
+	guess_sector(d, sc);
+	for (gp = d->d_gl; gp && (gp->g_sec <= sec); gp = gp->g_next)
+		if (gp->g_sec == sec)
+			return (1);
+	return (0);
+}
+
+/*
+ * the multiples of unit, coarse to fine.
+ */
+
+static void dl_grid(disk_desc *d, scan_desc *sc, s64_t unit)
+{
+	s64_t top, step, sec;
+
+	if (unit <= 0)
+		return;
+	for (top = unit; top * 2 < d->d_nsecs; top *= 2)
+		;
+	for (step = top; !dl_timeout() && (step >= unit); step /= 2)
+		for (sec = step; !dl_expired && (sec < d->d_nsecs); sec += step)
+			if ((step == top) || (sec % (2 * step))) {
+				sc->s_in_ext = sc->s_end_of_ext = 0;
+				dl_visit(d, sc, sec);
+			}
+}
+
+/*
+ * the sectors following each guess. Partitions are often
+ * next to each other and logical partitions follow their
+ * extended ptbl.
+ */
+
+static void dl_near(disk_desc *d, scan_desc *sc)
+{
+	dos_guessed_pt *gp;
+	s64_t sec, from, near = DL_NEAR / d->d_ssize;
+	int again = 1;
+
+	while (again && !dl_timeout()) {
+		again = 0;
+		for (gp = d->d_gl; gp && !dl_expired; gp = gp->g_next) {
+			if (gp->g_dl)
+				continue;
+			gp->g_dl = 1;
+			from = gp->g_ext ? gp->g_sec + 1 : gp->g_sec + gp_size(gp);
+			sc->s_in_ext = gp->g_ext;
+			sc->s_end_of_ext = 0;
+			for (sec = from; !dl_expired && (sec < from + near); sec += sc->s_incr)
+				if (dl_visit(d, sc, sec)) {
+					again = 1;
+					break;
+				}
+		}
+	}
+}
+
+/*
+ * the prescan leaves the extended ptbl state of the sequential
+ * scan (maybe resumed) as it found it.
+ */
+
+static void dl_prescan(disk_desc *d, scan_desc *sc)
+{
+	int in_ext = sc->s_in_ext, end_of_ext = sc->s_end_of_ext;
+
+	if (d->d_nsecs == 0)
+		return;
+	sc->s_in_ext = sc->s_end_of_ext = 0;
+	dl_visit(d, sc, d->d_dg.d_s);
+	dl_grid(d, sc, DL_ALIGN / d->d_ssize);
+	dl_near(d, sc);
+	dl_grid(d, sc, d->d_dg.d_s * d->d_dg.d_h);
+	dl_grid(d, sc, d->d_dg.d_s);
+	dl_near(d, sc);
+	sc->s_in_ext = in_ext;
+	sc->s_end_of_ext = end_of_ext;
+}
+
+/*
+ * a known guess at the scan position changes the extended
+ * ptbl state as if guess_sector() had found it there.
+ */
+
+static void dl_pass(scan_desc *sc, dos_guessed_pt *gp)
+{
+	if (gp->g_ext) {
+		if (!sc->s_in_ext) {
+			sc->s_in_ext = 1;
+			sc->s_end_of_ext = 0;
+		} else if (no_of_ext_partitions(gp->g_p) == 0)
+			sc->s_end_of_ext = 1;
+	} else if (sc->s_end_of_ext)
+		sc->s_in_ext = 0;
+}
+
+/*
+ * the sequential scan passes over what is known already. The
+ * sorted guesses are walked along with the scan position, a
+ * rejected guess makes the walk start over.
+ */
+
+static s64_t dl_skip(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	dos_guessed_pt *gp;
+	s64_t from;
+
+	if (sc->s_dlnext == 0)
+		sc->s_dlnext = &d->d_gl;
+	do {
+		from = sec;
+		for (; (gp = *sc->s_dlnext) && (gp->g_sec <= sec); sc->s_dlnext = &gp->g_next) {
+			if (gp->g_sec == sec) {
+				dl_pass(sc, gp);
+				sec += sc->s_incr;
+			}
+			if (f_fast && !gp->g_ext)
+				sc->s_dlend = max(sc->s_dlend, gp->g_sec + gp_size(gp));
+		}
+		if (sc->s_dlend > sec)
+			sec += (sc->s_dlend - sec + sc->s_incr - 1) / sc->s_incr * sc->s_incr;
+	} while (sec != from);
+	return (sec);
+}
+
+/*
+ * the disk is covered by the partitions found and the part
+ * the sequential scan got through.
+ */
+
+static void dl_report(disk_desc *d, s64_t from, s64_t to)
+{
+	dos_guessed_pt *gp;
+	range_list cov;
+	s_range *r;
+	s64_t end = 0, n = 0;
+
+	memset(&cov, 0, sizeof(cov));
+	for (gp = d->d_gl; gp; gp = gp->g_next)
+		if (!gp->g_ext)
+			add_range(&cov, gp->g_sec, gp->g_sec + gp_size(gp), gp->g_sec);
+	add_range(&cov, from, to, from);
+	qsort(cov.rl_r, cov.rl_n, sizeof(s_range), cmp_range);
+	for (r = cov.rl_r; r < &cov.rl_r[cov.rl_n]; r++) {
+		if (r->r_end <= end)
+			continue;
+		n += r->r_end - max(r->r_start, end);
+		end = r->r_end;
+	}
+	free_ranges(&cov);
+	if (d->d_nsecs)
+		pr(MSG, dl_expired ? PM_DLEXPIRED : PM_DLDONE, dl_probes, (int)(min(n, d->d_nsecs) * 100 / d->d_nsecs));
+}
+
+/*
+ * adaptive scan: the disk is read in large chunks and each
+ * sector position is screened by the module prefilters and
+ * the ptbl signature. Only positions passing the screen are
+ * read as a window and given to the modules, so the scan
+ * still covers every sector where a module or an extended
+ * ptbl could be recognized.
+ */
+
+static int ad_screen(disk_desc *d, byte_t *buf, s64_t sec)
+{
+	g_module *m;
+	byte_t *sbuf = d->d_sbuf;
+	int hit = 0;
+
+	d->d_sbuf = buf;
+	bpb_decode(buf, &d->d_bpb);
+	for (m = g_mod_head(); m && !hit; m = m->m_next)
+		hit = (m->m_pfun == 0) || (*m->m_pfun)(d, m);
+	if (!hit && f_testext && boundary_fun(d, sec))
+		hit = is_ext_parttable(d, buf);
+	d->d_sbuf = sbuf;
+	return (hit);
+}
+
+static int ad_candidate(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	ssize_t rd;
+	s64_t k = sec - sc->s_cstart;
+
+	if ((k < 0) || (k + sc->s_nsecs > sc->s_cnsecs)) {
+		if (l64seek(d->d_fd, sec * d->d_ssize, SEEK_SET) == -1)
+			pr(FATAL, EM_SEEKFAILURE, d->d_dev);
+		rd = bread(d->d_fd, sc->s_chunk, d->d_ssize, AD_CHUNK / d->d_ssize + sc->s_nsecs);
+		sc->s_cstart = sec;
+		sc->s_cnsecs = (rd > 0) ? rd / d->d_ssize : 0;
+		k = 0;
+
+		/*
+		 * read errors and the end of the disk are left
+		 * to the normal scan.
+		 */
+
+		if (sc->s_nsecs > sc->s_cnsecs)
+			return (1);
+	}
+	sc->s_screened++;
+	if (!ad_screen(d, sc->s_chunk + k * d->d_ssize, sec))
+		return (0);
+	sc->s_evaluated++;
+	return (1);
+}
+
+/*
+ * entropy skipping: nothing can be recognized inside encrypted
+ * or compressed data. Once the windows have had high entropy for
+ * a whole probe step, only the step boundaries are probed until
+ * a window with lower entropy turns up. The gap before it is
+ * scanned normally.
+ */
+
+static void en_close(scan_desc *sc)
+{
+	if (sc->s_ent_skip >= 0)
+		add_range(&sc->s_ent, sc->s_ent_skip, sc->s_ent_last, sc->s_ent_skip);
+	sc->s_ent_from = sc->s_ent_skip = -1;
+}
+
+static s64_t en_next(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	unsigned long hist[256];
+	s64_t next;
+	int n = min(sc->s_bsize, EN_SAMPLE);
+
+	memset(hist, 0, sizeof(hist));
+	byte_histogram(d->d_sbuf, n, hist);
+	if (content_class(hist, n) != CC_ENTROPY) {
+		if (sc->s_ent_skip < 0) {
+			sc->s_ent_from = -1;
+			return (sec + sc->s_incr);
+		}
+		next = sc->s_ent_last + sc->s_incr;
+		sc->s_ent_hold = sec + 1;
+		en_close(sc);
+		return (next);
+	}
+	if (sc->s_ent_from < 0)
+		sc->s_ent_from = sec;
+	if ((sec < sc->s_ent_hold) || (sec - sc->s_ent_from < sc->s_entstep))
+		return (sec + sc->s_incr);
+	if (sc->s_ent_skip < 0)
+		sc->s_ent_skip = sec + sc->s_incr;
+	sc->s_ent_last = sec;
+	return (sec + sc->s_entstep - sec % sc->s_entstep);
+}
+
+static void en_report(disk_desc *d, scan_desc *sc, s64_t end)
+{
+	s_range *r;
+	s64_t n = 0, s;
+
+	if (sc->s_ent_skip >= 0) {
+		sc->s_ent_last = d->d_nsecs ? min(end, d->d_nsecs) : end;
+		en_close(sc);
+	}
+	for (r = sc->s_ent.rl_r; r < &sc->s_ent.rl_r[sc->s_ent.rl_n]; r++)
+		n += r->r_end - r->r_start;
+	if (n == 0)
+		return;
+	s2mb(d, n);
+	s = sc->s_entstep;
+	s *= d->d_ssize;
+	pr(MSG, PM_ENTSKIPPED, sc->s_ent.rl_n, n, s / 1024);
+	if (f_verbose)
+		for (r = sc->s_ent.rl_r; r < &sc->s_ent.rl_r[sc->s_ent.rl_n]; r++)
+			pr(MSG, PM_ENTEXTENT, r->r_start, r->r_end - 1);
+}
+
+/*
+ * the sequential scan starting at sector sec. Returns the
+ * sector the scan stopped at.
+ */
+
+static s64_t do_scan(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	ssize_t rd;
+	s64_t noffset;
+	time_t cktime = time(0) + ckinterval;
+
+	d->d_defer = sc->s_defer;
+	while (1) {
+		sec = trc_next(idx_next(sec, sc->s_incr), sc->s_incr);
+		if (sc->s_gpt.rl_n)
+			sec = gpt_skip(sc, sec);
+		if (sc->s_stop && (sec >= sc->s_stop))
+			break;
+		if (deadline) {
+			if (dl_timeout())
+				break;
+			sec = dl_skip(d, sc, sec);
+		}
+		if (sc->s_adapt && !ad_candidate(d, sc, sec)) {
+			if (maxsec && (sec > maxsec))
+				break;
+			sec += sc->s_incr;
+			continue;
+		}
+		rd = read_window(d, sc, sec);
+		if (rd == sc->s_bsize) {
+			if (maxsec && (sec > maxsec))
+				break;
+			d->d_nsb = sec;
+			if (sc->s_ncf)
+				cf_window(d, sc, sec);
+			if (idx_mode == IDX_RECORD) {
+				idx_sector(d, sec, sc->s_incr);
+				if (is_ext_parttable(d, d->d_sbuf))
+					idx_hit_ext(d);
+			}
+			noffset = guess_sector(d, sc);
+
+			/*
+			 * continue with the next sectors to investigate
+			 * (may be before the current ones).
+			 */
+
+			if (noffset && f_fast) {
+				if (noffset % sc->s_incr)
+					noffset += sc->s_incr - noffset % sc->s_incr;
+				if (f_backfill)
+					add_range(&sc->s_bf, sec + sc->s_incr, sec + noffset, sec);
+				if (sc->s_entstep) {
+					sc->s_ent_last = sec;
+					en_close(sc);
+				}
+				sec += noffset;
+			} else if (sc->s_entstep)
+				sec = en_next(d, sc, sec);
+			else
+				sec += sc->s_incr;
+
+			if (ckfile && (time(0) >= cktime)) {
+				write_checkpoint(d, sc, sec);
+				cktime = time(0) + ckinterval;
+			}
+			continue;
+		}
+
+		/*
+		 * short read?
+		 */
+
+		if ((rd > 0) && (sec + sc->s_nsecs + 1 < d->d_nsecs)) {
+			/*
+			 * short read not at end of disk
+			 */
+
+			pr(f_skiperrors ? WARN : FATAL, EM_SHORTBREAD, sec, rd, sc->s_bsize);
+			sec += max(rd / d->d_ssize, 1);
+			continue;
+		}
+
+		if (rd == -1) {
+			/*
+			 * EIO is ignored (skipping current sector(s))
+			 */
+
+			if (f_skiperrors && (berrno == EIO)) {
+				pr(WARN, EM_BADREADIO, sec);
+				add_range(&sc->s_bad, sec, sec + sc->s_incr, sec);
+				sec += sc->s_incr;
+				continue;
+			}
+			pr(FATAL, EM_READERROR, d->d_dev, sec, strerror(berrno));
+		}
+		break;
+	}
+	d->d_defer = 0;
+	return (sec);
+}
+
+/*
+ * serve the confirmations left after the scan stopped at sec,
+ * then scan the ranges of rejected guesses. Their first sector
+ * is looked at without deferring, else the rejected module would
+ * win there again over the guesses the provisional one beat.
+ * The rest may find new provisional guesses.
+ */
+
+static void cf_finish(disk_desc *d, scan_desc *sc, s64_t sec)
+{
+	range_list rb;
+	s_range *r;
+	s64_t entstep = sc->s_entstep;
+	int defer = sc->s_defer;
+
+	sc->s_entstep = 0;
+	while (1) {
+		cf_serve(d, sc, sec);
+		if (sc->s_rb.rl_n == 0)
+			break;
+		rb = sc->s_rb;
+		memset(&sc->s_rb, 0, sizeof(range_list));
+		sc->s_in_ext = 0;
+		for (r = rb.rl_r; r < &rb.rl_r[rb.rl_n]; r++) {
+			sc->s_defer = 0;
+			sc->s_stop = r->r_start + 1;
+			sec = do_scan(d, sc, r->r_start);
+			sc->s_defer = defer;
+			if (sec < r->r_end) {
+				sc->s_stop = r->r_end;
+				sec = do_scan(d, sc, sec);
+			}
+		}
+		sc->s_stop = 0;
+		free_ranges(&rb);
+	}
+	sc->s_entstep = entstep;
+}
+
+/*
+ * probe mode: investigate the given sectors only.
+ */
+
+static int cmp_s64(const void *a, const void *b)
+{
+	s64_t x = *(s64_t *)a, y = *(s64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+static void do_probes(disk_desc *d, scan_desc *sc)
+{
+	int i;
+
+	qsort(probes, nprobes, sizeof(s64_t), cmp_s64);
+	for (i = 0; i < nprobes; i++) {
+		if (i && (probes[i] == probes[i - 1]))
+			continue;
+		if ((d->d_nsecs && (probes[i] >= d->d_nsecs)) || (read_window(d, sc, probes[i]) != sc->s_bsize)) {
+			pr(WARN, EM_PROBEREAD, probes[i]);
+			continue;
+		}
+		d->d_nsb = probes[i];
+		guess_sector(d, sc);
+	}
 }
 
-static void add_guessed_p(disk_desc *d, dos_part_entry *p, int cnt)
+/*
+ * survey mode: classify a stratified random sample of windows
+ * instead of scanning, print the estimated layout of the disk
+ * and the time a full scan would take.
+ */
+
+static double sv_now()
 {
-	dos_guessed_pt *gpt;
+	struct timeval tv;
 
-	if (d->d_gl == 0)
-		gpt = d->d_gl = (dos_guessed_pt *)alloc(sizeof(dos_guessed_pt));
-	else {
-		for (gpt = d->d_gl; gpt->g_next; gpt = gpt->g_next)
-			;
-		gpt->g_next = (dos_guessed_pt *)alloc(sizeof(dos_guessed_pt));
-		gpt = gpt->g_next;
-	}
+	gettimeofday(&tv, 0);
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
 
-	gpt->g_ext = (cnt > 1);
-	for (; cnt > 0; cnt--)
-		memcpy(&gpt->g_p[cnt - 1], &p[cnt - 1], sizeof(dos_part_entry));
-	gpt->g_sec = d->d_nsb;
+static int sv_classify(disk_desc *d, scan_desc *sc, long *mcount, s64_t *mfirst)
+{
+	g_module *m;
+	unsigned long hist[256];
+	int i, cl = CC_UNKNOWN;
+
+	if (is_ext_parttable(d, d->d_sbuf))
+		return (SV_PTBL);
+	bpb_decode(d->d_sbuf, &d->d_bpb);
+	for (i = 0, m = g_mod_head(); m; m = m->m_next, i++)
+		if (m->m_pfun && (*m->m_pfun)(d, m)) {
+			if (mcount[i]++ == 0)
+				mfirst[i] = d->d_nsb;
+			cl = SV_META;
+		}
+	if (cl == SV_META)
+		return (cl);
+	memset(hist, 0, sizeof(hist));
+	byte_histogram(d->d_sbuf, sc->s_bsize, hist);
+	return (content_class(hist, sc->s_bsize));
 }
 
-static g_module *get_best_guess(g_module **g, int count)
+static void do_survey(disk_desc *d, scan_desc *sc)
 {
-	int mx, i;
-	float bestg = 0.0;
+	static char mapc[SV_NCLASSES] = {'?', '.', '-', '#', '=', 'P', 'M'};
+	g_module *m;
+	s64_t from, to, span, st, grain, sec, nwin, nbytes;
+	long i, n, nread = 0, count[SV_NCLASSES], cc[SV_NCLASSES], *mcount;
+	int c, j, w;
+	s64_t *mfirst;
+	byte_t *cl;
+	char map[SV_MAPWIDTH + 1];
+	double t, rate;
+
+	from = skipsec ? skipsec : d->d_dg.d_s;
+	to = maxsec ? min(maxsec, d->d_nsecs) : d->d_nsecs;
+	span = to - from - sc->s_nsecs + 1;
+	if (span <= 0) {
+		pr(ERROR, EM_SVNOSIZE, d->d_dev);
+		return;
+	}
 
 	/*
-	 * up to now the best guess is simple that one which
-	 * reported the largest probability (if there are more
-	 * than one, the last one of them).
+	 * one window per stratum, on the coarsest power of two
+	 * boundary (up to 1mb) the strata allow.
 	 */
 
-	for (mx = i = 0; i < count; i++)
-		if (g[i]->m_guess * g[i]->m_weight > bestg)
-			bestg = g[mx = i]->m_guess * g[i]->m_weight;
-
-	return ((bestg > 0.0) ? g[mx] : 0);
-}
+	n = (survey > span) ? span : survey;
+	st = span / n;
+	for (grain = 1; (grain * 2 <= st) && (grain * 2 <= DL_ALIGN / d->d_ssize); grain *= 2)
+		;
+
+	cl = alloc(n);
+	mcount = (long *)alloc(g_mod_count() * sizeof(long));
+	mfirst = (s64_t *)alloc(g_mod_count() * sizeof(s64_t));
+	memset(count, 0, sizeof(count));
+	srandom(d->d_nsecs);
+	t = sv_now();
+	for (i = 0; i < n; i++) {
+		sec = from + i * st + (((s64_t)random() << 31) | random()) % st;
+		sec -= sec % grain;
+		if (sec < from + i * st)
+			sec += grain;
+		if (read_window(d, sc, sec) != sc->s_bsize)
+			c = CC_UNKNOWN;
+		else {
+			d->d_nsb = sec;
+			nread++;
+			c = sv_classify(d, sc, mcount, mfirst);
+		}
+		cl[i] = c;
+		count[c]++;
+	}
+	t = max(sv_now() - t, 0.000001);
 
-static int mod_is_aligned(disk_desc *d, g_module *m)
-{
-	s64_t al;
+	/*
+	 * a column shows a ptbl or fs metadata if one of its
+	 * windows does, else its most frequent class.
+	 */
 
-	switch (m->m_align) {
-	case 'h':
-		return (on_head_boundary(d, d->d_nsb));
+	w = (n < SV_MAPWIDTH) ? n : SV_MAPWIDTH;
+	for (j = 0; j < w; j++) {
+		memset(cc, 0, sizeof(cc));
+		for (i = j * n / w; i < (j + 1) * n / w; i++)
+			cc[cl[i]]++;
+		c = cc[SV_PTBL] ? SV_PTBL : (cc[SV_META] ? SV_META : CC_UNKNOWN);
+		if (c == CC_UNKNOWN)
+			for (i = CC_ZERO; i <= CC_DATA; i++)
+				if (cc[i] > cc[c])
+					c = i;
+		map[j] = mapc[c];
+	}
+	map[w] = 0;
+
+	nbytes = (s64_t)nread * sc->s_bsize / (1024 * 1024);
+	pr(MSG, PM_SVHEADER, n, from, to, nbytes, t);
+	pr(MSG, PM_SVCLASSES, count[CC_ZERO], count[CC_UNIFORM], count[CC_ENTROPY], count[CC_DATA], count[SV_PTBL],
+		count[SV_META], count[CC_UNKNOWN]);
+	pr(MSG, PM_SVMAP, (to - from) * d->d_ssize / 1024 / w, map);
+	pr(MSG, PM_SVLEGEND);
+	for (i = 0, m = g_mod_head(); m; m = m->m_next, i++)
+		if (mcount[i])
+			pr(MSG, PM_SVMOD, m->m_desc ? m->m_desc : m->m_name, mcount[i], mfirst[i]);
 
-	case 'c':
-		return (on_cyl_boundary(d, d->d_nsb));
+	/*
+	 * consecutive windows of a sequential scan overlap, each
+	 * position adds at most s_incr sectors to read.
+	 */
 
-	case 1:
-	case 's':
-		return (1);
-	default:
-		if (m->m_align > 0) {
-			al = d->d_nsb;
-			al %= m->m_align;
-			return (al == 0);
-		}
-		break;
-	}
-	return (1);
+	nwin = (to - from + sc->s_incr - 1) / sc->s_incr;
+	nbytes = nwin * min(sc->s_bsize, (s64_t)sc->s_incr * d->d_ssize);
+	rate = nread ? nread * (double)sc->s_bsize / t : 0.0;
+	sec = rate ? (s64_t)(nbytes / rate) : 0;
+	nbytes /= 1024 * 1024;
+	pr(MSG, PM_SVESTIMATE, nwin, nbytes, rate / 1024 / 1024, (long)(sec / 3600), (long)(sec / 60 % 60),
+		(long)(sec % 60));
+
+	free((void *)cl);
+	free((void *)mcount);
+	free((void *)mfirst);
 }
 
 /*
@@ -881,20 +2523,28 @@ static int mod_is_aligned(disk_desc *d, g_module *m)
 
 static void do_guess_loop(disk_desc *d)
 {
-	g_module *m, **guesses;
-	unsigned long incr = 0;
-	int nsecs, in_ext = 0, end_of_ext = 0, psize;
-	ssize_t rd, bsize = d->d_ssize;
-	s64_t bincr, noffset, start;
-	byte_t *ubuf;
-
-	if ((d->d_fd = open(d->d_dev, O_RDONLY)) == -1)
+	g_module *m;
+	scan_desc sc;
+	s64_t sec, start, rsec = 0;
+	int psize, i;
+	ssize_t bsize = d->d_ssize;
+
+	if (trc_mode == TRC_REPLAY) {
+		if (rdev && ((d->d_fd = open(rdev, O_RDONLY)) == -1))
+			pr(FATAL, EM_OPENFAIL, rdev, strerror(errno));
+	} else if ((d->d_fd = open(d->d_dev, O_RDONLY)) == -1)
 		pr(FATAL, EM_OPENFAIL, d->d_dev, strerror(errno));
 
 #if HAVE_POSIX_FADVISE
-	posix_fadvise(d->d_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
-	posix_fadvise(d->d_fd, 0, 0, POSIX_FADV_WILLNEED);
+	if (nprobes || survey)
+		posix_fadvise(d->d_fd, 0, 0, POSIX_FADV_RANDOM);
+	else {
+		posix_fadvise(d->d_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(d->d_fd, 0, 0, POSIX_FADV_WILLNEED);
+	}
 #endif /* HAVE_POSIX_FADVISE */
+	if (trcfile && !f_replay)
+		trc_create(d, trcfile);
 	/*
 	 * initialize modules. Each should return the minimum
 	 * size in bytes it wants to receive for a test.
@@ -911,216 +2561,144 @@ static void do_guess_loop(disk_desc *d)
 
 	if (bsize % d->d_ssize)
 		bsize += d->d_ssize - bsize % d->d_ssize;
-	nsecs = bsize / d->d_ssize;
-	switch (increment) {
-	case 's':
-		incr = 1;
-		break;
-	case 'h':
-		incr = d->d_dg.d_s;
-		break;
-	case 'c':
-		incr = d->d_dg.d_s * d->d_dg.d_h;
-		break;
-	default:
-		incr = increment;
-		break;
+	for (i = 0, m = g_mod_head(); m; m = m->m_next)
+		m->m_order = i++;
+	memset(&sc, 0, sizeof(sc));
+	sc.s_bsize = bsize;
+	sc.s_nsecs = bsize / d->d_ssize;
+	sc.s_incr = incr_sectors(d, increment);
+	sc.s_adapt = (increment == 'a') && (trc_mode != TRC_REPLAY);
+	if (f_entskip && (trc_mode != TRC_REPLAY)) {
+		sc.s_entstep = entincrement ? incr_sectors(d, entincrement) : EN_DEFSTEP / d->d_ssize;
+		sc.s_ent_from = sc.s_ent_skip = -1;
 	}
-	if (incr == 0)
-		incr = 1;
 
-	boundary_fun = (incr == 1) ? on_head_boundary : on_cyl_boundary;
+	/*
+	 * traces, indexes and checkpoints record the guesses as
+	 * they are found, the deadline scan and interactive mode
+	 * rely on them at once.
+	 */
+
+	sc.s_defer = f_defer && (trc_mode == TRC_NONE) && (idx_mode != IDX_RECORD) && !ckfile && !deadline && !f_interactive;
+
+	/*
+	 * traces refer to modules by their position in the list and
+	 * want all hits, like an index being recorded.
+	 */
+
+	sc.s_reorder = (trc_mode == TRC_NONE) && (idx_mode != IDX_RECORD);
+
+	boundary_fun = (sc.s_incr == 1) ? on_head_boundary : on_cyl_boundary;
 	psize = getpagesize();
-	ubuf = alloc(bsize + psize);
-	d->d_sbuf = align(ubuf, psize);
+	sc.s_ubuf = alloc(bsize + psize);
+	d->d_sbuf = align(sc.s_ubuf, psize);
+	if (sc.s_adapt) {
+		sc.s_cubuf = alloc(AD_CHUNK + bsize + psize);
+		sc.s_chunk = align(sc.s_cubuf, psize);
+	}
 	d->d_nsb = 0;
-	bincr = incr * d->d_ssize;
-
-	start = skipsec ? skipsec : d->d_dg.d_s;
-	d->d_nsb = start - incr;
-	start *= d->d_ssize;
-	if (l64seek(d->d_fd, start, SEEK_SET) == -1)
-		pr(FATAL, EM_SEEKFAILURE, d->d_dev);
+	bc_create(d, bcmb);
 
 	/*
 	 * do the work: read blocks, distribute to modules, check
 	 * for probable hits.
 	 */
 
-	guesses = (g_module **)alloc(g_mod_count() * sizeof(g_module *));
+	sc.s_guesses = (g_module **)gm_arena(d, g_mod_count() * sizeof(g_module *));
 	pr(MSG, DM_STARTSCAN);
 
-scanloop:
-	while ((rd = bread(d->d_fd, d->d_sbuf, d->d_ssize, nsecs)) == bsize) {
-		int mod, have_ext = 0;
-		g_module *bg;
-		s64_t sz, ofs, fpos;
-
-		d->d_nsb += incr;
-		noffset = 0;
-		ofs = d->d_nsb;
-		s2mb(d, ofs);
-		fpos = d->d_nsb * d->d_ssize + bsize;
-		if (maxsec && (d->d_nsb > maxsec))
-			break;
-
+	if (survey)
+		do_survey(d, &sc);
+	else if (nprobes)
+		do_probes(d, &sc);
+	else {
 		/*
-		 * reset modules
+		 * the checkpoint comes first, the GPT and the deadline
+		 * prescan pass over the guesses it knows.
 		 */
 
-		for (m = g_mod_head(); m; m = m->m_next)
-			m->m_skip = 0;
-
-	guessit:
-		bg = 0;
-		mod = 0;
-		for (m = g_mod_head(); m; m = m->m_next) {
-			if (m->m_skip || (in_ext && m->m_notinext) || !mod_is_aligned(d, m))
-				continue;
-
+		if (f_resume)
+			rsec = resume_scan(d, &sc);
+		if (f_gpt && (trc_mode == TRC_NONE) && !f_shard)
+			do_gpt(d, &sc);
+		if (idxfile && (trc_mode != TRC_REPLAY))
+			idx_open(d, idxfile);
+		sec = skipsec ? skipsec : d->d_dg.d_s;
+		if (f_shard && (sec > d->d_dg.d_s) && ((sec - d->d_dg.d_s) % sc.s_incr)) {
 			/*
-			 * because a gmodule is allowed to seek on
-			 * d->d_fd the current file position must be
-			 * restored after calling it.
+			 * a shard must scan the positions a serial scan
+			 * would scan.
 			 */
 
-			memset(&m->m_part, 0, sizeof(dos_part_entry));
-			m->m_guess = GM_NO;
-			if ((*m->m_gfun)(d, m) && (m->m_guess * m->m_weight >= GM_PERHAPS))
-				guesses[mod++] = m;
-			l64seek(d->d_fd, fpos, SEEK_SET);
-		}
-
-		/*
-		 * now fetch the best guess.
-		 */
-
-		if (mod && (bg = get_best_guess(guesses, mod))) {
-			noffset = bg->m_part.p_size;
-			fillin_dos_chs(d, &bg->m_part, 0);
-		}
-
-		/*
-		 * extended partition begin?
-		 */
-
-		if (f_testext && boundary_fun(d, d->d_nsb) && (!bg || !bg->m_hasptbl) && is_ext_parttable(d, d->d_sbuf)) {
-			dos_part_entry *p;
-			int no_ext;
-
-			p = (dos_part_entry *)(d->d_sbuf + DOSPARTOFF);
-			no_ext = no_of_ext_partitions(p);
-			if (!in_ext) {
-				pr(MSG, PM_POSSIBLEEXTPART, ofs);
-				in_ext = 1;
-				end_of_ext = 0;
-				noffset = 0;
-			} else if (no_ext == 0)
-				end_of_ext = 1;
-
-			if (in_ext) {
-				if (f_interactive) {
-					if (yesno(DM_ACCEPTGUESS))
-						add_guessed_p(d, p, have_ext = NDOSPARTS);
-					else if (mod && bg) {
-						bg->m_skip = 1;
-						goto guessit;
-					}
-				} else
-					add_guessed_p(d, p, have_ext = NDOSPARTS);
-			}
-		}
-
-		if (!have_ext && noffset) {
-			sz = noffset;
-			s2mb(d, sz);
-			if (in_ext)
-				pr(MSG, "   ");
-			pr(MSG, PM_POSSIBLEPART, bg->m_desc ? bg->m_desc : bg->m_name, sz, ofs);
-			if (f_verbose)
-				print_partition(d, &bg->m_part, in_ext ? 1 : 0, 0);
-			if (f_interactive)
-				if (!yesno(DM_ACCEPTGUESS)) {
-					noffset = 0;
-					if (mod && bg) {
-						bg->m_skip = 1;
-						goto guessit;
-					}
-				}
-
-			if (noffset) {
-				add_guessed_p(d, &bg->m_part, 1);
-				if (end_of_ext)
-					in_ext = 0;
-			}
+			sec += sc.s_incr - (sec - d->d_dg.d_s) % sc.s_incr;
 		}
+		start = sec;
+		if (f_resume)
+			sec = rsec;
+		if (deadline)
+			dl_prescan(d, &sc);
+		sec = do_scan(d, &sc, sec);
+		if (sc.s_defer)
+			cf_finish(d, &sc, sec);
+		if (f_shard)
+			trc_state(start, maxsec ? maxsec : d->d_nsecs, sec, sc.s_in_ext, sc.s_end_of_ext);
+		if (f_backfill && !dl_expired)
+			do_backfill(d, &sc);
+		if (f_endprobe && !f_shard)
+			do_endprobes(d, &sc);
+		if (sc.s_entstep)
+			en_report(d, &sc, sec);
+		if (deadline)
+			dl_report(d, start, dl_expired ? sec : d->d_nsecs);
+		idx_close(d, f_verbose);
 
 		/*
-		 * seek to next sectors to investigate (may seek
-		 * backwards).
+		 * the scan is complete, the checkpoint isn't needed
+		 * anymore. A scan stopped by the deadline can be
+		 * continued later.
 		 */
 
-		if (noffset && f_fast) {
-			if (noffset % incr)
-				noffset += incr - noffset % incr;
-			d->d_nsb += noffset - incr;
-			noffset -= nsecs;
-			noffset *= d->d_ssize;
-			if (l64seek(d->d_fd, noffset, SEEK_CUR) == -1)
-				pr(FATAL, EM_SEEKFAILURE, d->d_dev);
-		} else if (bincr)
-			if (l64seek(d->d_fd, bincr - bsize, SEEK_CUR) == -1)
-				pr(FATAL, EM_SEEKFAILURE, d->d_dev);
+		if (ckfile && dl_expired)
+			write_checkpoint(d, &sc, sec);
+		else if (ckfile)
+			unlink(ckfile);
 	}
-
-	/*
-	 * short read?
-	 */
-
-	if ((rd > 0) && (rd < bsize))
-		if (d->d_nsb + nsecs + 1 < d->d_nsecs) {
-			/*
-			 * short read not at end of disk
-			 */
-
-			pr(f_skiperrors ? WARN : FATAL, EM_SHORTBREAD, d->d_nsb, rd, bsize);
-			noffset = l64tell(d->d_fd);
-			noffset /= d->d_ssize;
-			noffset *= d->d_ssize;
-			if (l64seek(d->d_fd, noffset, SEEK_SET) == -1)
-				pr(FATAL, EM_SEEKFAILURE, d->d_dev);
-			d->d_nsb = l64tell(d->d_fd) / d->d_ssize - incr;
-			goto scanloop;
-		}
-
-	if (rd == -1) {
-		/*
-		 * EIO is ignored (skipping current sector(s))
-		 */
-
-		if (f_skiperrors && (berrno == EIO)) {
-			pr(WARN, EM_BADREADIO, d->d_nsb);
-			noffset = l64tell(d->d_fd);
-			noffset /= d->d_ssize;
-			noffset += incr;
-			noffset *= d->d_ssize;
-			if (l64seek(d->d_fd, noffset, SEEK_SET) == -1)
-				pr(FATAL, EM_SEEKFAILURE, d->d_dev);
-			d->d_nsb = l64tell(d->d_fd) / d->d_ssize - incr;
-			goto scanloop;
-		}
-		pr(FATAL, EM_READERROR, d->d_dev, d->d_nsb, strerror(berrno));
+	if (f_verbose && sc.s_bad.rl_n)
+		pr(MSG, PM_BADRANGES, sc.s_bad.rl_n);
+	if (f_verbose && sc.s_adapt)
+		pr(MSG, PM_ADSTATS, sc.s_screened, sc.s_evaluated);
+	if (f_verbose && d->d_bc)
+		pr(MSG, PM_BCSTATS, d->d_bc->c_hits, d->d_bc->c_misses);
+	if (f_verbose && sc.s_defer)
+		pr(MSG, PM_CFSTATS, sc.s_cfwin, sc.s_cfread, sc.s_cfrej);
+	for (m = g_mod_head(); m; m = m->m_next)
+		if (m->m_overbudget)
+			pr(WARN, EM_OVERBUDGET, m->m_name, m->m_overbudget);
+	if (f_verbose && sc.s_nevals) {
+		pr(MSG, PM_MODSTATS, sc.s_nevals);
+		for (m = g_mod_head(); m; m = m->m_next)
+			if (m->m_calls || m->m_saved)
+				pr(MSG, PM_MODSTAT, m->m_name, m->m_calls, m->m_timed ? m->m_ns / 1000.0 / m->m_timed : 0.0,
+					m->m_hits, m->m_saved);
 	}
+	g_mod_sort(cmp_modorder);
 
 	pr(MSG, DM_ENDSCAN);
-	if (guesses)
-		free((void *)guesses);
+	free_ranges(&sc.s_bf);
+	free_ranges(&sc.s_bad);
+	free_ranges(&sc.s_gpt);
+	free_ranges(&sc.s_ent);
+	free_ranges(&sc.s_rb);
 
 	for (m = g_mod_head(); m; m = m->m_next)
 		if (m->m_term)
 			(*m->m_term)(d);
-	free((void *)ubuf);
-	close(d->d_fd);
+	bc_destroy(d);
+	free((void *)sc.s_ubuf);
+	if (sc.s_cubuf)
+		free((void *)sc.s_cubuf);
+	if (d->d_fd != -1)
+		close(d->d_fd);
 }
 
 static void edit_partition(disk_desc *d, dos_part_entry *p)
@@ -1253,6 +2831,151 @@ static void warn_invalid(disk_desc *d, dos_part_entry *p, char *w)
 	}
 }
 
+/*
+ * overlapping guesses: keep the set of non-overlapping ones
+ * with the largest sum of m_guess * m_weight (weighted interval
+ * scheduling). The size only decides between sets of the same
+ * sum, else one bogus superblock claiming the whole disk would
+ * outweigh all the real partitions inside it. Of sets equal in
+ * both the one ending first is kept. Extended ptbls take no
+ * space. Returns the number of guesses discarded.
+ */
+
+typedef struct
+{
+	dos_guessed_pt	*w_gp;
+	s64_t		w_start;
+	s64_t		w_end;
+	double		w_weight;
+} wis_item;
+
+static int cmp_wis(const void *a, const void *b)
+{
+	const wis_item *x = a, *y = b;
+
+	if (x->w_end != y->w_end)
+		return ((x->w_end > y->w_end) - (x->w_end < y->w_end));
+	return ((x->w_start > y->w_start) - (x->w_start < y->w_start));
+}
+
+#define WIS_EPS		1e-6
+
+static int wis_better(double w1, s64_t c1, double w2, s64_t c2)
+{
+	if ((w1 > w2 + WIS_EPS) || (w2 > w1 + WIS_EPS))
+		return (w1 > w2);
+	return (c1 > c2);
+}
+
+static int overlaps(dos_guessed_pt *a, dos_guessed_pt *b)
+{
+	dos_part_entry *p = &a->g_p[0], *q = &b->g_p[0];
+
+	return ((p->p_start < q->p_start + max(gp_size(b), 1)) && (q->p_start < p->p_start + max(gp_size(a), 1)));
+}
+
+static int select_guesses(disk_desc *d)
+{
+	dos_guessed_pt *gp, *kp, **gpp;
+	dos_part_entry *p;
+	wis_item *w;
+	double *opt, tw;
+	s64_t *cov, tc;
+	int *prev, n, i, j, lo, hi, ndisc = 0;
+
+	for (n = 0, gp = d->d_gl; gp; gp = gp->g_next)
+		if (!gp->g_ext && !gp->g_inv)
+			n++;
+	if (n < 2)
+		return (0);
+
+	w = (wis_item *)alloc(n * sizeof(wis_item));
+	opt = (double *)alloc((n + 1) * sizeof(double));
+	cov = (s64_t *)alloc((n + 1) * sizeof(s64_t));
+	prev = (int *)alloc(n * sizeof(int));
+	for (i = 0, gp = d->d_gl; gp; gp = gp->g_next) {
+		if (gp->g_ext || gp->g_inv)
+			continue;
+		p = &gp->g_p[0];
+		w[i].w_gp = gp;
+		w[i].w_start = p->p_start;
+		w[i].w_end = w[i].w_start + max(gp_size(gp), 1);
+		w[i].w_weight = gp->g_weight;
+		gp->g_ovl = 1;
+		i++;
+	}
+	qsort(w, n, sizeof(wis_item), cmp_wis);
+
+	/*
+	 * prev[j]: last guess ending before w[j] starts, opt[j]
+	 * and cov[j]: best sum and its size of the first j guesses.
+	 */
+
+	for (j = 0; j < n; j++) {
+		for (lo = 0, hi = j; lo < hi;) {
+			i = (lo + hi) / 2;
+			if (w[i].w_end <= w[j].w_start)
+				lo = i + 1;
+			else
+				hi = i;
+		}
+		prev[j] = lo - 1;
+		tw = w[j].w_weight + opt[prev[j] + 1];
+		tc = w[j].w_end - w[j].w_start + cov[prev[j] + 1];
+		if (wis_better(tw, tc, opt[j], cov[j])) {
+			opt[j + 1] = tw;
+			cov[j + 1] = tc;
+		} else {
+			opt[j + 1] = opt[j];
+			cov[j + 1] = cov[j];
+		}
+	}
+	for (j = n - 1; j >= 0;)
+		if (wis_better(w[j].w_weight + opt[prev[j] + 1], w[j].w_end - w[j].w_start + cov[prev[j] + 1], opt[j], cov[j])) {
+			w[j].w_gp->g_ovl = 0;
+			j = prev[j];
+		} else
+			j--;
+
+	/*
+	 * guesses from skipped ranges conflict with the one which
+	 * caused the skip, let the user decide which to keep.
+	 */
+
+	for (i = 0; i < n; i++) {
+		gp = w[i].w_gp;
+		if (!gp->g_ovl || !gp->g_bf)
+			continue;
+		for (kp = d->d_gl; kp; kp = kp->g_next)
+			if (!kp->g_ext && !kp->g_inv && !kp->g_ovl && overlaps(gp, kp))
+				break;
+		if (kp == 0)
+			continue;
+		pr(WARN, EM_BFCONFLICT, gp->g_sec, kp->g_sec);
+		if (f_interactive && yesno(DM_KEEPBACKFILL)) {
+			for (; kp; kp = kp->g_next)
+				if (!kp->g_ext && !kp->g_inv && !kp->g_ovl && overlaps(gp, kp))
+					kp->g_ovl = 1;
+			gp->g_ovl = 0;
+		}
+	}
+
+	d->d_gltail = 0;
+	for (gpp = &d->d_gl; (gp = *gpp);)
+		if (gp->g_ovl) {
+			*gpp = gp->g_next;
+			ndisc++;
+		} else {
+			d->d_gltail = gp;
+			gpp = &gp->g_next;
+		}
+	free((void *)w);
+	free((void *)opt);
+	free((void *)cov);
+	free((void *)prev);
+	return (ndisc);
+}
+
 /*
  * after having gathered a list of possible partitions they
  * have to be checked for consistency. This routine must be
@@ -1261,7 +2984,7 @@ static void warn_invalid(disk_desc *d, dos_part_entry *p, char *w)
 
 static int check_partition_list(disk_desc *d)
 {
-	dos_guessed_pt *gp, *prev;
+	dos_guessed_pt *gp;
 	dos_part_entry *p, *rp, *ep, *lep;
 	int n, npp, epp, maxp, in_ext;
 	s64_t size, ofs;
@@ -1271,36 +2994,10 @@ static int check_partition_list(disk_desc *d)
 	pr(MSG, DM_STARTCHECK);
 
 	/*
-	 * 1. pass: discard overlapping entries. This means
-	 * that the first entry is assumed to be ok.
+	 * 1. pass: discard overlapping entries.
 	 */
 
-	ofs = 0;
-	prev = 0;
-	npp = 0;
-	for (gp = d->d_gl; gp; gp = gp->g_next) {
-		if (gp->g_ext || gp->g_inv)
-			continue;
-		p = &gp->g_p[0];
-		if (gp == d->d_gl)
-			ofs = p->p_start + p->p_size;
-		else {
-			if (p->p_start < ofs) {
-				/*
-				 * overlap. unlink and discard.
-				 */
-
-				prev->g_next = gp->g_next;
-				free((void *)gp);
-				gp = prev;
-				npp++;
-			} else
-				ofs += p->p_size;
-		}
-		prev = gp;
-	}
-
-	if (npp)
+	if ((npp = select_guesses(d)))
 		pr(WARN, EM_DISCARDOVLP, npp);
 
 	/*
@@ -1586,10 +3283,129 @@ static int compare_parttables(disk_desc *d)
 	return (ret);
 }
 
+/*
+ * scan increment: number or 's', 'h', 'c', 'a'.
+ */
+
+static unsigned long get_increment(char *arg)
+{
+	unsigned long incr;
+
+	if ((*arg == 's') || (*arg == 'h') || (*arg == 'c') || (*arg == 'a'))
+		return (*arg);
+	incr = strtoul(arg, 0, 0);
+	if (errno == ERANGE)
+		pr(FATAL, EM_INVVALUE);
+	return (incr);
+}
+
+static void add_probe(s64_t sec)
+{
+	if (nprobes == maxprobes) {
+		maxprobes = maxprobes ? 2 * maxprobes : 64;
+		if ((probes = (s64_t *)realloc(probes, maxprobes * sizeof(s64_t))) == 0)
+			pr(FATAL, EM_MALLOCFAILED, maxprobes * sizeof(s64_t));
+	}
+	probes[nprobes++] = sec;
+}
+
+/*
+ * sectors to probe, separated by commas or white space.
+ */
+
+static void add_probes(char *arg)
+{
+	char *p;
+	s64_t sec;
+
+	while (*arg) {
+		if (isspace(*arg) || (*arg == ',')) {
+			arg++;
+			continue;
+		}
+		errno = 0;
+		sec = strtoll(arg, &p, 0);
+		if ((p == arg) || (errno == ERANGE) || (sec < 0) || (*p && !isspace(*p) && (*p != ',')))
+			pr(FATAL, EM_INVVALUE);
+		add_probe(sec);
+		arg = p;
+	}
+}
+
+/*
+ * a probe file contains sector numbers, everything after
+ * a '#' on a line is ignored.
+ */
+
+static void read_probe_file(char *name)
+{
+	FILE *fp;
+	char *line = 0, *p;
+	size_t len = 0;
+
+	if ((fp = fopen(name, "r")) == 0)
+		pr(FATAL, EM_OPENPROBES, name, strerror(errno));
+	while (getline(&line, &len, fp) != -1) {
+		if ((p = strchr(line, '#')))
+			*p = 0;
+		add_probes(line);
+	}
+	if (line)
+		free((void *)line);
+	fclose(fp);
+}
+
 /*
  * main
  */
 
+enum
+{
+	OPT_BACKFILL = 256,
+	OPT_PROBE,
+	OPT_CHECKPOINT,
+	OPT_CKINTERVAL,
+	OPT_RESUME,
+	OPT_INDEX,
+	OPT_TRACE,
+	OPT_REPLAY,
+	OPT_SHARD,
+	OPT_MERGE,
+	OPT_DEVICE,
+	OPT_DEADLINE,
+	OPT_SURVEY,
+	OPT_ENDPROBE,
+	OPT_NOGPT,
+	OPT_ENTSKIP,
+	OPT_CACHE,
+	OPT_DEFER,
+	OPT_RBUDGET,
+	OPT_TBUDGET,
+};
+
+static struct option longopts[] = {
+	{"backfill", optional_argument, 0, OPT_BACKFILL},
+	{"probe", required_argument, 0, OPT_PROBE},
+	{"checkpoint", required_argument, 0, OPT_CHECKPOINT},
+	{"checkpoint-interval", required_argument, 0, OPT_CKINTERVAL},
+	{"resume", no_argument, 0, OPT_RESUME},
+	{"index", required_argument, 0, OPT_INDEX},
+	{"trace", required_argument, 0, OPT_TRACE},
+	{"replay", required_argument, 0, OPT_REPLAY},
+	{"shard", required_argument, 0, OPT_SHARD},
+	{"merge", no_argument, 0, OPT_MERGE},
+	{"device", required_argument, 0, OPT_DEVICE},
+	{"deadline", required_argument, 0, OPT_DEADLINE},
+	{"survey", optional_argument, 0, OPT_SURVEY},
+	{"end-probes", no_argument, 0, OPT_ENDPROBE},
+	{"no-gpt", no_argument, 0, OPT_NOGPT},
+	{"skip-entropy", optional_argument, 0, OPT_ENTSKIP},
+	{"cache", required_argument, 0, OPT_CACHE},
+	{"defer", no_argument, 0, OPT_DEFER},
+	{"read-budget", required_argument, 0, OPT_RBUDGET},
+	{"time-budget", required_argument, 0, OPT_TBUDGET},
+	{0, 0, 0, 0}};
+
 int main(int ac, char **av)
 {
 	char *optstr = "b:C:cdEefghiK:k:Ll:n:qs:t:VvW:w:";
@@ -1598,7 +3414,7 @@ int main(int ac, char **av)
 	disk_desc *d;
 
 	g_mod_addinternals();
-	while ((opt = getopt(ac, av, optstr)) != -1)
+	while ((opt = getopt_long(ac, av, optstr, longopts, 0)) != -1)
 		switch (opt) {
 		case 'b':
 			backup = optarg;
@@ -1651,13 +3467,7 @@ int main(int ac, char **av)
 				pr(FATAL, EM_INVVALUE);
 			break;
 		case 'n':
-			if ((*optarg == 's') || (*optarg == 'h') || (*optarg == 'c'))
-				increment = *optarg;
-			else {
-				increment = strtoul(optarg, 0, 0);
-				if (errno == ERANGE)
-					pr(FATAL, EM_INVVALUE);
-			}
+			increment = get_increment(optarg);
 			break;
 		case 'l':
 			if (logfile)
@@ -1692,6 +3502,83 @@ int main(int ac, char **av)
 		case 'W':
 			odev = optarg;
 			break;
+		case OPT_PROBE:
+			if (*optarg == '@')
+				read_probe_file(optarg + 1);
+			else
+				add_probes(optarg);
+			break;
+		case OPT_CHECKPOINT:
+			ckfile = optarg;
+			break;
+		case OPT_CKINTERVAL:
+			if ((ckinterval = strtol(optarg, 0, 0)) <= 0)
+				pr(FATAL, EM_INVVALUE);
+			break;
+		case OPT_RESUME:
+			f_resume = 1;
+			break;
+		case OPT_INDEX:
+			idxfile = optarg;
+			break;
+		case OPT_TRACE:
+			trcfile = optarg;
+			break;
+		case OPT_REPLAY:
+			trcfile = optarg;
+			f_replay = 1;
+			break;
+		case OPT_SHARD:
+			trcfile = optarg;
+			f_shard = 1;
+			break;
+		case OPT_MERGE:
+			f_merge = f_replay = 1;
+			break;
+		case OPT_DEVICE:
+			rdev = optarg;
+			break;
+		case OPT_DEADLINE:
+			if ((deadline = strtol(optarg, 0, 0)) <= 0)
+				pr(FATAL, EM_INVVALUE);
+			dl_end = time(0) + deadline;
+			break;
+		case OPT_SURVEY:
+			survey = SV_DEFSAMPLES;
+			if (optarg && ((survey = strtol(optarg, 0, 0)) <= 0))
+				pr(FATAL, EM_INVVALUE);
+			break;
+		case OPT_ENDPROBE:
+			f_endprobe = 1;
+			break;
+		case OPT_NOGPT:
+			f_gpt = 0;
+			break;
+		case OPT_CACHE:
+			if ((bcmb = strtol(optarg, 0, 0)) < 0)
+				pr(FATAL, EM_INVVALUE);
+			break;
+		case OPT_DEFER:
+			f_defer = 1;
+			break;
+		case OPT_RBUDGET:
+			if ((rbkb = strtol(optarg, 0, 0)) < 0)
+				pr(FATAL, EM_INVVALUE);
+			break;
+		case OPT_TBUDGET:
+			if ((rbms = strtol(optarg, 0, 0)) < 0)
+				pr(FATAL, EM_INVVALUE);
+			break;
+		case OPT_ENTSKIP:
+			f_entskip = 1;
+			if (optarg)
+				entincrement = get_increment(optarg);
+			break;
+		case OPT_BACKFILL:
+			f_backfill = 1;
+			if (optarg)
+				bfincrement = get_increment(optarg);
+			break;
 		case '?':
 		case 'h':
 		default:
@@ -1699,7 +3586,9 @@ int main(int ac, char **av)
 			return (EXIT_FAILURE);
 		}
 
-	if ((optind + 1) != ac) {
+	if ((f_merge ? (optind >= ac) : ((optind + (f_replay ? 0 : 1)) != ac)) || (f_resume && !ckfile) ||
+		(rdev && !f_replay) || (f_shard && f_replay) ||
+		(survey && (nprobes || f_resume || (trcfile && !f_replay)))) {
 		usage();
 		return (EXIT_FAILURE);
 	}
@@ -1715,7 +3604,10 @@ int main(int ac, char **av)
 		f_interactive = 0;
 
 	sync();
-	d = get_disk_desc(av[optind], sectsize);
+	if (f_merge)
+		d = replay_disk_desc(&av[optind], ac - optind);
+	else
+		d = f_replay ? replay_disk_desc(&trcfile, 1) : get_disk_desc(av[optind], sectsize);
 	if (f_verbose > 0)
 		print_disk_desc(d);
 	if (f_verbose > 2)
@@ -1725,6 +3617,8 @@ int main(int ac, char **av)
 		sleep(1);
 		sync();
 		do_guess_loop(d);
+	}
+	if (!f_dontguess && !survey) {
 		no_of_incons = check_partition_list(d);
 		pr(MSG, DM_GUESSEDPTBL);
 		print_ptable(d, &d->d_gpt, 0);
@@ -1739,6 +3633,9 @@ int main(int ac, char **av)
 		}
 	}
 	free_disk_desc(d);
+	trc_close(f_verbose);
+	if (probes)
+		free((void *)probes);
 	if (logfile)
 		fclose(logfile);
 
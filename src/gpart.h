@@ -96,13 +96,74 @@ typedef struct dos_gp
 	dos_part_entry	g_p[NDOSPARTS];
 	struct dos_gp	*g_next;
 	s64_t		g_sec;		/* found there */
+	struct g_mod	*g_mod;		/* guessing module */
+	float		g_weight;	/* its m_guess * m_weight */
+	s64_t		g_size;		/* size if g_p[0].p_size overflows */
 	unsigned int	g_ext	: 1;	/* extended ptbl */
 	unsigned int	g_prim	: 1;	/* primary partition */
 	unsigned int	g_log	: 1;	/* logical partition */
 	unsigned int	g_inv	: 1;	/* invalid entry */
 	unsigned int	g_orph	: 1;	/* orphaned partition */
+	unsigned int	g_bf	: 1;	/* found in a skipped range */
+	unsigned int	g_dl	: 1;	/* neighbourhood scanned (deadline) */
+	unsigned int	g_ovl	: 1;	/* discarded, overlaps a better guess */
+	unsigned int	g_prov	: 1;	/* its confirmation is pending */
 } dos_guessed_pt;
 
+/*
+ * the BIOS parameter block of a DOS style boot sector, decoded
+ * once per window for the fat, ntfs and hpfs modules.
+ */
+
+typedef struct
+{
+	uint16_t	b_ssize;	/* bytes per sector */
+	uint8_t		b_media;
+	uint8_t		b_extsig;	/* 0x29 FAT12/16, 0x28 HPFS */
+	uint16_t	b_fatlen;	/* 16 bit FAT length, 0 on FAT32 */
+	uint32_t	b_nsecs;	/* 16 bit sector count or 32 bit one */
+	uint64_t	b_nsecs64;	/* NTFS sector count */
+	uint32_t	b_mftcl;	/* NTFS clusters per MFT record */
+	uint32_t	b_idxcl;	/* and per index record */
+	char		b_fstype[8];	/* "FAT12   " etc. */
+	unsigned int	b_jmp	: 1;	/* short jump (eb xx 90) */
+	unsigned int	b_magic	: 1;	/* DOSPTMAGIC at the end */
+	unsigned int	b_fat	: 1;	/* looks like FAT */
+	unsigned int	b_ntfs	: 1;	/* NTFS oem id */
+	unsigned int	b_hpfs	: 1;	/* HPFS signature */
+} bpb_info;
+
+void bpb_decode(byte_t *,bpb_info *);
+
+/*
+ * scratch buffers, page aligned, kept for the whole scan
+ */
+
+#define GM_NBUFS	4
+
+typedef struct
+{
+	byte_t		*b_ubuf;	/* unaligned */
+	byte_t		*b_buf;
+	size_t		b_size;
+	int		b_used;
+} scratch_buf;
+
+/*
+ * memory living as long as the disk description (guesses,
+ * extended ptbls) is carved from chunks which are released
+ * together, see gm_arena().
+ */
+
+#define GM_ARCHUNK	(64 * 1024)
+
+typedef struct gm_chunk
+{
+	struct gm_chunk	*a_next;
+	size_t		a_size;		/* usable bytes after the header */
+	size_t		a_used;
+} gm_chunk;
+
 /*
  * disk description used
  */
@@ -124,19 +185,147 @@ typedef struct
 	} d_dg;
 	unsigned int	d_lba	: 1;
 	unsigned int	d_dosc	: 1;	/* dos compatible? (g_c < 1024) */
+	unsigned int	d_defer	: 1;	/* modules may defer confirmations */
+	unsigned int	d_rbover : 1;	/* read budget exceeded */
 	dos_part_table	d_pt;		/* table of primary partitions */
 	dos_part_table	d_gpt;		/* guessed ptbl */
 	dos_guessed_pt	*d_gl;		/* list of gathered guesses */
+	dos_guessed_pt	*d_gltail;	/* and its last one */
+	bpb_info	d_bpb;		/* of the window in d_sbuf */
+	struct blk_cache *d_bc;		/* module read cache */
+	scratch_buf	d_bufs[GM_NBUFS];
+	gm_chunk	*d_arena;
+	s64_t		d_rbmax;	/* read budget in bytes, 0: none */
+	s64_t		d_rbused;
+	s64_t		d_rbend;	/* time budget end in us, 0: none */
 } disk_desc;
 
 
+/*
+ * a range of sectors [r_start, r_end)
+ */
+
+typedef struct
+{
+	s64_t		r_start;
+	s64_t		r_end;
+	s64_t		r_sec;		/* sector of the causing guess */
+} s_range;
+
+typedef struct
+{
+	s_range		*rl_r;
+	int		rl_n, rl_max;
+} range_list;
+
+
 struct disk_geom *disk_geometry(disk_desc *);
 int reread_partition_table(int);
+ssize_t gm_read(disk_desc *, s64_t, void *, size_t);
+void gm_budget(disk_desc *, s64_t, long);
+byte_t *gm_getbuf(disk_desc *, size_t);
+void gm_putbuf(disk_desc *, byte_t *);
+void gm_freebufs(disk_desc *);
+byte_t *gm_arena(disk_desc *, size_t);
+void gm_freearena(disk_desc *);
+
+/*
+ * content classes
+ */
+
+#define CC_UNKNOWN	0
+#define CC_ZERO		1		/* all bytes zero */
+#define CC_UNIFORM	2		/* all bytes the same */
+#define CC_ENTROPY	3		/* random looking, encrypted/compressed */
+#define CC_DATA		4		/* anything else */
+
+#define CC_ENTROPY_MIN	(7.8)		/* bits per byte */
+
+void byte_histogram(byte_t *,size_t,unsigned long *);
+double byte_entropy(unsigned long *,unsigned long);
+int content_class(unsigned long *,unsigned long);
 
 #define s2mb(d,s)	{ (s)*=(d)->d_ssize; (s)/=1024; (s)/=1024; }
 #define align(b,s)	(byte_t *)(((size_t)(b)+(s)-1)&~((s)-1))
 
 #include "gmodules.h"
 
+/*
+ * a confirmation deferred by a module
+ */
+
+#define CF_BATCH	64		/* served at once */
+
+typedef struct
+{
+	s64_t		c_ofs;		/* bytes to read */
+	int		c_len;
+	g_module	*c_mod;
+	dos_guessed_pt	*c_gp;		/* the provisional guess */
+	byte_t		c_key[GM_CFKEYLEN];
+} cf_item;
+
+/*
+ * state of a running scan
+ */
+
+typedef struct
+{
+	g_module	**s_guesses;	/* modules with a guess */
+	byte_t		*s_ubuf;	/* unaligned sector buffer */
+	ssize_t		s_bsize;	/* bytes read per window */
+	int		s_nsecs;	/* sectors read per window */
+	unsigned long	s_incr;		/* scan increment in sectors */
+	int		s_in_ext;	/* within extended ptbl chain */
+	int		s_end_of_ext;	/* last ext. ptbl of the chain seen */
+	range_list	s_bf;		/* ranges skipped by fast jumps */
+	range_list	s_bad;		/* unreadable ranges skipped */
+	range_list	s_gpt;		/* ranges described by a valid GPT */
+	int		s_adapt;	/* adaptive scan (-n a) */
+	byte_t		*s_cubuf;	/* unaligned chunk buffer */
+	byte_t		*s_chunk;	/* sectors from s_cstart on */
+	s64_t		s_cstart;
+	int		s_cnsecs;	/* # of sectors in s_chunk */
+	s64_t		s_screened;	/* positions screened */
+	s64_t		s_evaluated;	/* positions given to the modules */
+	s64_t		s_entstep;	/* probe step in high entropy runs */
+	s64_t		s_ent_from;	/* start of a high entropy run or -1 */
+	s64_t		s_ent_skip;	/* first sector skipped in it or -1 */
+	s64_t		s_ent_last;	/* last high entropy probe */
+	s64_t		s_ent_hold;	/* no skipping before this sector */
+	range_list	s_ent;		/* high entropy extents skipped */
+	int		s_defer;	/* deferred confirmations (--defer) */
+	cf_item		s_cf[CF_BATCH];	/* pending confirmations */
+	int		s_ncf;
+	range_list	s_rb;		/* jumps over rejected guesses */
+	s64_t		s_stop;		/* rescans end there */
+	s64_t		s_cfwin;	/* confirmed from the scan window */
+	s64_t		s_cfread;	/* confirmed by a read */
+	s64_t		s_cfrej;	/* rejected */
+	int		s_reorder;	/* modules reordered, early exit */
+	s64_t		s_nevals;	/* windows given to the modules */
+	dos_guessed_pt	**s_dlnext;	/* deadline: first guess not passed */
+	s64_t		s_dlend;	/* end of the partitions passed */
+} scan_desc;
+
+#define BF_DEFINCR	(1024 * 1024)	/* default backfill step in bytes */
+#define DL_ALIGN	(1024 * 1024)	/* alignment probed first (deadline) */
+#define DL_NEAR		(1024 * 1024)	/* scanned after each guess (deadline) */
+#define AD_CHUNK	(1024 * 1024)	/* read at once by the adaptive scan */
+#define EN_DEFSTEP	(1024 * 1024)	/* probe step in high entropy runs */
+#define EN_SAMPLE	4096		/* bytes of a window for its entropy */
+#define SV_DEFSAMPLES	4096		/* windows read by a survey */
+#define SV_MAPWIDTH	64		/* columns of the layout map */
+#define RO_INTERVAL	4096		/* windows between module reorderings */
+#define RO_SAMPLE	64		/* module checks timed every ... windows */
+
+/*
+ * survey classes in addition to the content classes
+ */
+
+#define SV_PTBL		(CC_DATA + 1)	/* partition table sector */
+#define SV_META		(CC_DATA + 2)	/* fs metadata (module prefilter) */
+#define SV_NCLASSES	(CC_DATA + 3)
+
 
 #endif /* _GPART_H */
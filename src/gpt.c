@@ -0,0 +1,130 @@
+/*
+ * gpt.c -- gpart GUID partition table support
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include "gpart.h"
+#include "gpt.h"
+
+static uint32_t crctab[256];
+
+static uint32_t gpt_crc32(byte_t *buf, size_t len)
+{
+	uint32_t c;
+	int i, j;
+
+	if (crctab[1] == 0)
+		for (i = 0; i < 256; i++) {
+			for (c = i, j = 0; j < 8; j++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crctab[i] = c;
+		}
+	for (c = 0xffffffff; len > 0; len--)
+		c = crctab[(c ^ *buf++) & 0xff] ^ (c >> 8);
+	return (c ^ 0xffffffff);
+}
+
+/*
+ * plausibility of a GPT header in buf, which has been read
+ * from sector lba.
+ */
+
+int gpt_is_header(disk_desc *d, byte_t *buf, s64_t lba)
+{
+	gpt_header *h = (gpt_header *)buf;
+
+	if (memcmp(h->h_sig, GPT_SIGNATURE, sizeof(h->h_sig)))
+		return (0);
+	if ((le32(h->h_size) < GPT_HDRMINSIZE) || (le32(h->h_size) > d->d_ssize))
+		return (0);
+	if (le64(h->h_mylba) != lba)
+		return (0);
+	if ((le64(h->h_first) > le64(h->h_last)) || (d->d_nsecs && (le64(h->h_last) >= d->d_nsecs)))
+		return (0);
+	if ((le32(h->h_entsize) < GPT_ENTMINSIZE) || (le32(h->h_entsize) % 8))
+		return (0);
+	return (1);
+}
+
+int gpt_is_unused(gpt_entry *e)
+{
+	int i;
+
+	for (i = 0; i < sizeof(e->e_type); i++)
+		if (e->e_type[i])
+			return (0);
+	return (1);
+}
+
+/*
+ * read the header at lba and its entry array, check both
+ * crcs. Returns the entry array or 0.
+ */
+
+static byte_t *gpt_read_at(disk_desc *d, gpt_header *h, s64_t lba)
+{
+	byte_t *ubuf, *sbuf, *ents = 0;
+	uint32_t crc;
+	size_t psize = getpagesize(), len;
+	s64_t nsecs;
+
+	ubuf = alloc(d->d_ssize + psize);
+	sbuf = align(ubuf, psize);
+	if ((l64seek(d->d_fd, lba * d->d_ssize, SEEK_SET) == -1) || (bread(d->d_fd, sbuf, d->d_ssize, 1) != d->d_ssize) ||
+		!gpt_is_header(d, sbuf, lba))
+		goto out;
+	memcpy(h, sbuf, sizeof(gpt_header));
+	crc = le32(h->h_crc);
+	((gpt_header *)sbuf)->h_crc = 0;
+	if (gpt_crc32(sbuf, le32(h->h_size)) != crc)
+		goto out;
+
+	len = (size_t)le32(h->h_nents) * le32(h->h_entsize);
+	nsecs = (len + d->d_ssize - 1) / d->d_ssize;
+	if ((len == 0) || (nsecs > 1024) || (d->d_nsecs && (le64(h->h_entlba) + nsecs > d->d_nsecs)))
+		goto out;
+	free((void *)ubuf);
+	ubuf = alloc(nsecs * d->d_ssize + psize);
+	sbuf = align(ubuf, psize);
+	if ((l64seek(d->d_fd, le64(h->h_entlba) * d->d_ssize, SEEK_SET) == -1) ||
+		(bread(d->d_fd, sbuf, d->d_ssize, nsecs) != nsecs * d->d_ssize))
+		goto out;
+	if (gpt_crc32(sbuf, len) != le32(h->h_entcrc))
+		goto out;
+	ents = alloc(len);
+	memcpy(ents, sbuf, len);
+out:
+	free((void *)ubuf);
+	return (ents);
+}
+
+/*
+ * the primary GPT at lba 1, if it is damaged the backup at the
+ * last lba. The entry array returned must be freed.
+ */
+
+byte_t *gpt_read(disk_desc *d, gpt_header *h, int *backup)
+{
+	byte_t *ents;
+
+	*backup = 0;
+	if ((ents = gpt_read_at(d, h, 1)))
+		return (ents);
+	*backup = 1;
+	if (d->d_nsecs > 2)
+		ents = gpt_read_at(d, h, d->d_nsecs - 1);
+	return (ents);
+}
@@ -0,0 +1,64 @@
+/*
+ * gpt.h -- gpart GUID partition table header file
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _GPT_H
+#define _GPT_H
+
+#define GPT_SIGNATURE	"EFI PART"
+#define GPT_HDRMINSIZE	92
+#define GPT_ENTMINSIZE	128
+
+/*
+ * the primary header is at lba 1, the backup header at the
+ * last lba of the disk. All fields are little endian.
+ */
+
+typedef struct
+{
+	char		h_sig[8];
+	uint32_t	h_revision;
+	uint32_t	h_size;		/* header size */
+	uint32_t	h_crc;		/* crc32 of the header */
+	uint32_t	h_reserved;
+	uint64_t	h_mylba;	/* lba of this header */
+	uint64_t	h_altlba;	/* lba of the other header */
+	uint64_t	h_first;	/* first usable lba */
+	uint64_t	h_last;		/* last usable lba */
+	byte_t		h_guid[16];
+	uint64_t	h_entlba;	/* start of the entry array */
+	uint32_t	h_nents;	/* # of entries */
+	uint32_t	h_entsize;	/* size of an entry */
+	uint32_t	h_entcrc;	/* crc32 of the entry array */
+} __attribute__((packed)) gpt_header;
+
+/*
+ * partition entry, unused if the type guid is zero.
+ */
+
+typedef struct
+{
+	byte_t		e_type[16];	/* partition type guid */
+	byte_t		e_guid[16];	/* unique partition guid */
+	uint64_t	e_first;	/* first lba */
+	uint64_t	e_last;		/* last lba, inclusive */
+	uint64_t	e_attr;
+	uint16_t	e_name[36];	/* utf-16le */
+} __attribute__((packed)) gpt_entry;
+
+int gpt_is_header(disk_desc *, byte_t *, s64_t);
+int gpt_is_unused(gpt_entry *);
+byte_t *gpt_read(disk_desc *, gpt_header *, int *);
+
+#endif /* _GPT_H */
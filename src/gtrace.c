@@ -0,0 +1,569 @@
+/*
+ * gtrace.c -- gpart candidate trace recording and replay
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpart.h"
+#include "gtrace.h"
+
+int trc_mode = TRC_NONE;
+
+static char *t_file;
+static FILE *t_fp;
+
+/*
+ * recording state: the span of positions being extended.
+ */
+
+static s64_t t_start, t_last, t_stride;
+static int t_inspan;
+
+/*
+ * replay state
+ */
+
+static char t_dev[256];
+static s64_t t_end, t_missing, t_read;
+static int t_live;
+static trc_shard *t_shard;
+static int t_nshard, t_maxshard;
+static trc_span *t_span;
+static trc_hit *t_hit;
+static trc_ext *t_ext;
+static int t_nspan, t_nhit, t_next;
+static int t_maxspan, t_maxhit, t_maxext;
+static g_module **t_mods;
+static int t_nmods;
+
+static void put(void *p, size_t n)
+{
+	if ((trc_mode == TRC_RECORD) && (fwrite(p, n, 1, t_fp) != 1)) {
+		pr(ERROR, EM_TRCWRITE, t_file, strerror(errno));
+		trc_mode = TRC_NONE;
+	}
+}
+
+static void put_byte(int v)
+{
+	byte_t b = v;
+
+	put(&b, 1);
+}
+
+static void put_s64(s64_t v) { put(&v, sizeof(v)); }
+
+static int get(void *p, size_t n) { return (fread(p, n, 1, t_fp) == 1); }
+
+static void get_or_die(void *p, size_t n)
+{
+	if (!get(p, n))
+		pr(FATAL, EM_TRCINVALID, t_file);
+}
+
+static void flush_span()
+{
+	if (t_inspan) {
+		put_byte(TR_SPAN);
+		put_s64(t_start);
+		put_s64(t_last);
+		put_s64(t_stride);
+	}
+	t_inspan = 0;
+}
+
+/*
+ * start recording. The header describes the device as far
+ * as the scan and the checks need it.
+ */
+
+void trc_create(disk_desc *d, char *file)
+{
+	dos_part_table *pt;
+	g_module *m;
+	uint32_t v;
+	int n;
+
+	t_file = file;
+	if ((t_fp = fopen(file, "w")) == 0) {
+		pr(ERROR, EM_TRCWRITE, file, strerror(errno));
+		return;
+	}
+	trc_mode = TRC_RECORD;
+	put(TRC_MAGIC, strlen(TRC_MAGIC));
+	v = TRC_VERSION;
+	put(&v, sizeof(v));
+	v = TRC_BYTEORDER;
+	put(&v, sizeof(v));
+
+	n = min(strlen(d->d_dev), sizeof(t_dev) - 1);
+	put_byte(n);
+	put(d->d_dev, n);
+	put_s64(d->d_ssize);
+	put_s64(d->d_dg.d_c);
+	put_s64(d->d_dg.d_h);
+	put_s64(d->d_dg.d_s);
+	put_s64(d->d_dg.d_nsecs);
+	put_s64(d->d_dg.d_nsecs ? d->d_dg.d_nsecs : d->d_nsecs);
+
+	for (n = 0, pt = &d->d_pt; pt; pt = pt->t_ext)
+		n++;
+	put_byte(n);
+	for (pt = &d->d_pt; pt; pt = pt->t_ext)
+		put(pt->t_boot, 512);
+
+	put_byte(g_mod_count());
+	for (m = g_mod_head(); m; m = m->m_next) {
+		put_byte(strlen(m->m_name));
+		put(m->m_name, strlen(m->m_name));
+	}
+}
+
+/*
+ * the window at d->d_nsb is about to be evaluated.
+ */
+
+void trc_sector(disk_desc *d)
+{
+	dos_part_entry *p = (dos_part_entry *)(d->d_sbuf + DOSPARTOFF);
+	s64_t sec = d->d_nsb;
+
+	if (trc_mode != TRC_RECORD)
+		return;
+	if (t_inspan && (sec > t_last) && ((t_start == t_last) || (sec == t_last + t_stride))) {
+		if (t_start == t_last)
+			t_stride = sec - t_last;
+		t_last = sec;
+	} else {
+		flush_span();
+		t_start = t_last = sec;
+		t_stride = 1;
+		t_inspan = 1;
+	}
+
+	/*
+	 * whether it really is an extended ptbl depends on the
+	 * disk size, which may be overridden in the replay.
+	 */
+
+	if (*(uint16_t *)&p[NDOSPARTS] == le16(DOSPTMAGIC)) {
+		put_byte(TR_EXT);
+		put_s64(sec);
+		put(p, NDOSPARTS * sizeof(dos_part_entry));
+	}
+}
+
+/*
+ * a shard ends: where the scan would have continued and
+ * whether it was within an extended ptbl chain.
+ */
+
+void trc_state(s64_t first, s64_t last, s64_t next, int in_ext, int end_of_ext)
+{
+	if (trc_mode != TRC_RECORD)
+		return;
+	flush_span();
+	put_byte(TR_STATE);
+	put_s64(first);
+	put_s64(last);
+	put_s64(next);
+	put_byte(in_ext);
+	put_byte(end_of_ext);
+}
+
+void trc_hit_mod(disk_desc *d, g_module *m)
+{
+	g_module *t;
+	int n;
+
+	if ((trc_mode != TRC_RECORD) || (m->m_guess == GM_NO))
+		return;
+	for (n = 0, t = g_mod_head(); t && (t != m); t = t->m_next)
+		n++;
+	put_byte(TR_HIT);
+	put_s64(d->d_nsb);
+	put_byte(n);
+	put(&m->m_guess, sizeof(m->m_guess));
+	put(&m->m_part, sizeof(dos_part_entry));
+	put_s64(m->m_size);
+}
+
+static void *grow(void *p, int n, int *max, size_t sz)
+{
+	if (n < *max)
+		return (p);
+	*max = *max ? 2 * *max : 256;
+	if ((p = realloc(p, *max * sz)) == 0)
+		pr(FATAL, EM_MALLOCFAILED, *max * sz);
+	return (p);
+}
+
+static int cmp_span(const void *a, const void *b)
+{
+	s64_t x = ((trc_span *)a)->t_start, y = ((trc_span *)b)->t_start;
+
+	return ((x > y) - (x < y));
+}
+
+static int cmp_hit(const void *a, const void *b)
+{
+	trc_hit *x = (trc_hit *)a, *y = (trc_hit *)b;
+
+	if (x->t_sec != y->t_sec)
+		return ((x->t_sec > y->t_sec) - (x->t_sec < y->t_sec));
+	return ((x->t_mod > y->t_mod) - (x->t_mod < y->t_mod));
+}
+
+static int cmp_ext(const void *a, const void *b)
+{
+	s64_t x = ((trc_ext *)a)->t_sec, y = ((trc_ext *)b)->t_sec;
+
+	return ((x > y) - (x < y));
+}
+
+static int cmp_shard(const void *a, const void *b)
+{
+	s64_t x = ((trc_shard *)a)->t_first, y = ((trc_shard *)b)->t_first;
+
+	return ((x > y) - (x < y));
+}
+
+static void read_records()
+{
+	trc_span *sp;
+	trc_hit *h;
+	trc_ext *x;
+	trc_shard *sh;
+	byte_t type, modno;
+	int i, n;
+
+	while (1) {
+		if (!get(&type, 1)) {
+			pr(WARN, EM_TRCTRUNC, t_file);
+			break;
+		}
+		if (type == TR_END)
+			break;
+		switch (type) {
+		case TR_SPAN:
+			t_span = (trc_span *)grow(t_span, t_nspan, &t_maxspan, sizeof(trc_span));
+			sp = &t_span[t_nspan++];
+			get_or_die(&sp->t_start, sizeof(s64_t));
+			get_or_die(&sp->t_last, sizeof(s64_t));
+			get_or_die(&sp->t_stride, sizeof(s64_t));
+			if ((sp->t_stride <= 0) || (sp->t_last < sp->t_start))
+				pr(FATAL, EM_TRCINVALID, t_file);
+			break;
+		case TR_HIT:
+			t_hit = (trc_hit *)grow(t_hit, t_nhit, &t_maxhit, sizeof(trc_hit));
+			h = &t_hit[t_nhit];
+			get_or_die(&h->t_sec, sizeof(s64_t));
+			get_or_die(&modno, 1);
+			get_or_die(&h->t_guess, sizeof(float));
+			get_or_die(&h->t_part, sizeof(dos_part_entry));
+			get_or_die(&h->t_size, sizeof(s64_t));
+			if (modno >= t_nmods)
+				pr(FATAL, EM_TRCINVALID, t_file);
+			if ((h->t_mod = t_mods[modno]))
+				t_nhit++;
+			break;
+		case TR_EXT:
+			t_ext = (trc_ext *)grow(t_ext, t_next, &t_maxext, sizeof(trc_ext));
+			x = &t_ext[t_next++];
+			get_or_die(&x->t_sec, sizeof(s64_t));
+			get_or_die(x->t_parts, NDOSPARTS * sizeof(dos_part_entry));
+			break;
+		case TR_STATE:
+			t_shard = (trc_shard *)grow(t_shard, t_nshard, &t_maxshard, sizeof(trc_shard));
+			sh = &t_shard[t_nshard++];
+			sh->t_file = t_file;
+			get_or_die(&sh->t_first, sizeof(s64_t));
+			get_or_die(&sh->t_last, sizeof(s64_t));
+			get_or_die(&sh->t_next, sizeof(s64_t));
+			get_or_die(&sh->t_in_ext, 1);
+			get_or_die(&sh->t_end_of_ext, 1);
+			break;
+		default:
+			pr(FATAL, EM_TRCINVALID, t_file);
+		}
+	}
+
+	/*
+	 * a guess rejected interactively while recording has
+	 * been evaluated twice, shards may overlap.
+	 */
+
+	qsort(t_span, t_nspan, sizeof(trc_span), cmp_span);
+	for (i = 0; i < t_nspan; i++)
+		t_span[i].t_maxlast = i ? max(t_span[i - 1].t_maxlast, t_span[i].t_last) : t_span[i].t_last;
+	qsort(t_hit, t_nhit, sizeof(trc_hit), cmp_hit);
+	for (i = n = 0; i < t_nhit; i++)
+		if ((n == 0) || cmp_hit(&t_hit[n - 1], &t_hit[i]))
+			t_hit[n++] = t_hit[i];
+	t_nhit = n;
+	qsort(t_ext, t_next, sizeof(trc_ext), cmp_ext);
+}
+
+/*
+ * set up the disk description from a trace for a replay.
+ * The recorded geometry is returned in dg. Further traces
+ * (shards) must have been recorded from the same device.
+ */
+
+void trc_load(disk_desc *d, char *file, struct disk_geom *dg)
+{
+	dos_part_table *pt, tmp;
+	char magic[sizeof(TRC_MAGIC)], name[256];
+	struct disk_geom g;
+	uint32_t v, bo;
+	s64_t s[6];
+	byte_t n, i;
+	int first = (trc_mode != TRC_REPLAY);
+
+	t_file = file;
+	if ((t_fp = fopen(file, "r")) == 0)
+		pr(FATAL, EM_TRCREAD, file, strerror(errno));
+	get_or_die(magic, strlen(TRC_MAGIC));
+	get_or_die(&v, sizeof(v));
+	get_or_die(&bo, sizeof(bo));
+	if (memcmp(magic, TRC_MAGIC, strlen(TRC_MAGIC)) || (v != TRC_VERSION) || (bo != TRC_BYTEORDER))
+		pr(FATAL, EM_TRCINVALID, file);
+
+	get_or_die(&n, 1);
+	get_or_die(name, n);
+	name[n] = 0;
+	get_or_die(s, sizeof(s));
+	if ((s[0] < MINSSIZE) || (s[0] > MAXSSIZE))
+		pr(FATAL, EM_TRCINVALID, file);
+	g.d_c = s[1];
+	g.d_h = s[2];
+	g.d_s = s[3];
+	g.d_nsecs = s[4];
+	if (first) {
+		strcpy(t_dev, name);
+		d->d_dev = t_dev;
+		d->d_fd = -1;
+		d->d_ssize = s[0];
+		memcpy(dg, &g, sizeof(g));
+		t_end = s[5];
+	} else if ((d->d_ssize != s[0]) || (dg->d_c != g.d_c) || (dg->d_h != g.d_h) || (dg->d_s != g.d_s) ||
+			   (dg->d_nsecs != g.d_nsecs) || (t_end != s[5]))
+		pr(FATAL, EM_TRCOTHERDEV, file);
+
+	get_or_die(&n, 1);
+	for (i = 0, pt = &d->d_pt; i < n; i++) {
+		if (!first)
+			pt = &tmp;
+		else if (i)
+			pt = pt->t_ext = (dos_part_table *)gm_arena(d, sizeof(dos_part_table));
+		get_or_die(pt->t_boot, 512);
+	}
+
+	/*
+	 * module hits are matched by name, the trace may have
+	 * been recorded with another module order.
+	 */
+
+	get_or_die(&n, 1);
+	t_nmods = n;
+	if (t_mods)
+		free((void *)t_mods);
+	t_mods = (g_module **)alloc(max(t_nmods, 1) * sizeof(g_module *));
+	for (i = 0; i < t_nmods; i++) {
+		get_or_die(&n, 1);
+		get_or_die(name, n);
+		name[n] = 0;
+		if (((t_mods[i] = g_mod_lookup(GM_LOOKUP, name)) == 0) && first)
+			pr(WARN, EM_NOSUCHMOD, name);
+	}
+	read_records();
+	fclose(t_fp);
+	t_fp = 0;
+	trc_mode = TRC_REPLAY;
+}
+
+void trc_close(int verbose)
+{
+	trc_shard *sh;
+
+	if (t_fp) {
+		flush_span();
+		put_byte(TR_END);
+		if (fclose(t_fp) && (trc_mode == TRC_RECORD))
+			pr(ERROR, EM_TRCWRITE, t_file, strerror(errno));
+		t_fp = 0;
+	}
+	if (verbose && (trc_mode == TRC_REPLAY)) {
+		qsort(t_shard, t_nshard, sizeof(trc_shard), cmp_shard);
+		for (sh = t_shard; sh < &t_shard[t_nshard]; sh++)
+			pr(MSG, PM_TRCSHARD, sh->t_file, sh->t_first, sh->t_last, sh->t_next,
+			   sh->t_in_ext ? PM_TRCINEXT : "");
+		if (t_read)
+			pr(MSG, PM_TRCREAD, t_read);
+	}
+	if (t_missing)
+		pr(WARN, EM_TRCMISSING, t_missing);
+	if (t_shard)
+		free((void *)t_shard);
+	t_shard = 0;
+	t_nshard = t_maxshard = 0;
+	t_read = 0;
+	if (t_span)
+		free((void *)t_span);
+	if (t_hit)
+		free((void *)t_hit);
+	if (t_ext)
+		free((void *)t_ext);
+	if (t_mods)
+		free((void *)t_mods);
+	t_span = 0;
+	t_hit = 0;
+	t_ext = 0;
+	t_mods = 0;
+	t_nspan = t_nhit = t_next = t_missing = 0;
+	trc_mode = TRC_NONE;
+}
+
+/*
+ * replay lookups
+ */
+
+static trc_span *covering(s64_t sec)
+{
+	int lo = 0, hi = t_nspan - 1, mid;
+
+	/*
+	 * last span starting at or before sec, spans overlap if
+	 * a backfill or a probe was recorded.
+	 */
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (t_span[mid].t_start <= sec)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	for (; (hi >= 0) && (t_span[hi].t_maxlast >= sec); hi--)
+		if ((sec <= t_span[hi].t_last) && ((sec - t_span[hi].t_start) % t_span[hi].t_stride == 0))
+			return (&t_span[hi]);
+	return (0);
+}
+
+static trc_hit *first_hit(s64_t sec)
+{
+	int lo = 0, hi = t_nhit;
+
+	while (lo < hi)
+		if (t_hit[(lo + hi) / 2].t_sec < sec)
+			lo = (lo + hi) / 2 + 1;
+		else
+			hi = (lo + hi) / 2;
+	return (&t_hit[lo]);
+}
+
+static trc_ext *first_ext(s64_t sec)
+{
+	int lo = 0, hi = t_next;
+
+	while (lo < hi)
+		if (t_ext[(lo + hi) / 2].t_sec < sec)
+			lo = (lo + hi) / 2 + 1;
+		else
+			hi = (lo + hi) / 2;
+	return (&t_ext[lo]);
+}
+
+/*
+ * "read" the window at sec: only an extended ptbl candidate
+ * is put into the sector buffer, the modules answer from the
+ * trace.
+ */
+
+ssize_t trc_read(disk_desc *d, ssize_t bsize, int nsecs, s64_t sec)
+{
+	dos_part_entry *p = (dos_part_entry *)(d->d_sbuf + DOSPARTOFF);
+	trc_ext *x;
+
+	if (sec < 0)
+		return (-1);
+	t_live = 0;
+	if (t_end ? (sec + nsecs > t_end) : (!t_nspan || (sec > t_span[t_nspan - 1].t_maxlast)))
+		return (0);
+	if (!covering(sec) && (d->d_fd != -1)) {
+		/*
+		 * not in the trace, but the device is there.
+		 */
+
+		t_live = 1;
+		t_read++;
+		if (l64seek(d->d_fd, sec * d->d_ssize, SEEK_SET) == -1)
+			pr(FATAL, EM_SEEKFAILURE, d->d_dev);
+		return (bread(d->d_fd, d->d_sbuf, d->d_ssize, nsecs));
+	}
+	memset(d->d_sbuf, 0, d->d_ssize);
+	x = first_ext(sec);
+	if ((x < &t_ext[t_next]) && (x->t_sec == sec)) {
+		memcpy(p, x->t_parts, NDOSPARTS * sizeof(dos_part_entry));
+		*(uint16_t *)&p[NDOSPARTS] = le16(DOSPTMAGIC);
+	}
+	if (!covering(sec))
+		t_missing++;
+	return (bsize);
+}
+
+int trc_eval(disk_desc *d, g_module *m)
+{
+	trc_hit *h;
+
+	if (t_live)
+		return (-1);
+	for (h = first_hit(d->d_nsb); (h < &t_hit[t_nhit]) && (h->t_sec == d->d_nsb); h++)
+		if (h->t_mod == m) {
+			m->m_guess = h->t_guess;
+			memcpy(&m->m_part, &h->t_part, sizeof(dos_part_entry));
+			m->m_size = h->t_size;
+			return (1);
+		}
+	return (0);
+}
+
+/*
+ * the next position at or after sec (stepping by incr) with
+ * anything recorded or not covered by the trace.
+ */
+
+s64_t trc_next(s64_t sec, unsigned long incr)
+{
+	trc_span *sp;
+	trc_hit *h;
+	trc_ext *x;
+	s64_t to;
+
+	if (trc_mode != TRC_REPLAY)
+		return (sec);
+	while ((sp = covering(sec)) && (incr % sp->t_stride == 0)) {
+		to = sp->t_last + 1;
+		if (((h = first_hit(sec)) < &t_hit[t_nhit]) && (h->t_sec < to))
+			to = h->t_sec;
+		if (((x = first_ext(sec)) < &t_ext[t_next]) && (x->t_sec < to))
+			to = x->t_sec;
+		if (to <= sec)
+			break;
+		sec += (to - sec + incr - 1) / incr * incr;
+	}
+	return (sec);
+}
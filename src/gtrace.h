@@ -0,0 +1,95 @@
+/*
+ * gtrace.h -- gpart candidate trace header file
+ *
+ * gpart (c) 1999-2001 Michail Brzitwa <mb@ichabod.han.de>
+ * Guess PC-type hard disk partitions.
+ *
+ * gpart is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2, or (at your
+ * option) any later version.
+ *
+ * Created:   19.10.2026
+ *
+ */
+
+#ifndef _GTRACE_H
+#define _GTRACE_H
+
+/*
+ * a trace holds the raw output of all modules and every
+ * extended ptbl candidate at each evaluated position. A
+ * replay runs the scan and the checks from the trace
+ * instead of the disk, e.g. with other module weights.
+ */
+
+#define TRC_NONE	0
+#define TRC_RECORD	1
+#define TRC_REPLAY	2
+
+#define TRC_MAGIC	"GPARTTRC"
+#define TRC_VERSION	2
+#define TRC_BYTEORDER	0x01020304
+
+/*
+ * record types
+ */
+
+#define TR_SPAN		'S'		/* evaluated positions */
+#define TR_HIT		'H'		/* module hit */
+#define TR_EXT		'X'		/* extended ptbl candidate */
+#define TR_STATE	'T'		/* end of a shard */
+#define TR_END		'E'
+
+typedef struct
+{
+	s64_t		t_start;
+	s64_t		t_last;
+	s64_t		t_stride;
+	s64_t		t_maxlast;	/* max. t_last up to this span */
+} trc_span;
+
+typedef struct
+{
+	s64_t		t_sec;
+	g_module	*t_mod;
+	float		t_guess;
+	dos_part_entry	t_part;
+	s64_t		t_size;		/* m_size */
+} trc_hit;
+
+typedef struct
+{
+	s64_t		t_sec;
+	dos_part_entry	t_parts[NDOSPARTS];
+} trc_ext;
+
+/*
+ * a shard is a trace of part of the device. The scan of the
+ * next shard starts without knowing the jumps and extended
+ * ptbl chains crossing into it.
+ */
+
+typedef struct
+{
+	char		*t_file;
+	s64_t		t_first;	/* first sector to scan */
+	s64_t		t_last;		/* last sector to scan */
+	s64_t		t_next;		/* continue scanning here */
+	byte_t		t_in_ext;
+	byte_t		t_end_of_ext;
+} trc_shard;
+
+extern int trc_mode;
+
+void trc_create(disk_desc *, char *);
+void trc_load(disk_desc *, char *, struct disk_geom *);
+void trc_close(int);
+void trc_state(s64_t, s64_t, s64_t, int, int);
+void trc_sector(disk_desc *);
+void trc_hit_mod(disk_desc *, g_module *);
+ssize_t trc_read(disk_desc *, ssize_t, int, s64_t);
+int trc_eval(disk_desc *, g_module *);
+s64_t trc_next(s64_t, unsigned long);
+
+#endif /* _GTRACE_H */